@@ -0,0 +1,75 @@
+#ifndef BENCH_CLOCK_H
+#define BENCH_CLOCK_H
+
+#include <stdint.h>
+
+
+// RP2040: SysTick (24-bit down counter, processor clock) in cycles.
+// PC: CLOCK_MONOTONIC in ns.
+
+#if PICO_ON_DEVICE
+
+#include <hardware/clocks.h>
+#include <hardware/structs/systick.h>
+
+#define cBenchClockName  "systick"
+#define cBenchClockUnit  "cycles"
+
+static inline void benchClockInit(void)
+{
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // ENABLE | CLKSOURCE(processor)
+
+    return;
+}
+
+static inline uint32_t benchClockNow(void)
+{
+    return systick_hw->cvr;
+}
+
+static inline uint32_t benchClockElapsed(uint32_t start, uint32_t end)
+{
+    return (start - end) & 0x00FFFFFF;
+}
+
+static inline uint32_t benchClockHz(void)
+{
+    return clock_get_hz(clk_sys);
+}
+
+#else
+
+#include <time.h>
+
+#define cBenchClockName  "monotonic"
+#define cBenchClockUnit  "ns"
+
+static inline void benchClockInit(void)
+{
+    return;
+}
+
+static inline uint32_t benchClockNow(void)
+{
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+}
+
+static inline uint32_t benchClockElapsed(uint32_t start, uint32_t end)
+{
+    return end - start;
+}
+
+static inline uint32_t benchClockHz(void)
+{
+    return 1000000000u;
+}
+
+#endif
+
+
+#endif /* #ifndef BENCH_CLOCK_H */
@@ -0,0 +1,456 @@
+// Microbenchmark of the per-report hot path.
+// Each stage is measured per report over report sets and written as JSON.
+//
+// RP2040: result is printed to UART stdio after boot.
+// PC: usbhidproxy_bench [-n passes] [-k keyboard.txt] [-m mouse.txt]
+//     Recorded sets are text with one report per line in hex bytes
+//     (usbhid-dump output can be used as is).
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PICO_ON_DEVICE
+#include <pico/stdlib.h>
+#endif
+
+#include "bench_clock.h"
+#include "bench_reports.h"
+
+#include "buf_func.h"
+#include "hid_report_map.h"
+#include "hid_transform.h"
+#include "key_debounce.h"
+#include "mouse_coalesce.h"
+#include "poll_phase.h"
+#include "power_profile.h"
+#include "report_dedup.h"
+#include "report_ring.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+#define cBenchPassNumDefault  100
+#define cBenchSyntheticReportNum  256
+#define cBenchRecordedReportMax  1024
+
+#define cBenchInstance  0
+#define cBenchReportIntervalUs  1000 // Mocked time between reports of a set
+
+// Mocked clock of the power profile replay
+#define cBenchPowerPassUs  10 // Cost of one pass of the firmware loop
+#define cBenchPowerInputUs  8000 // Input interval while active
+#define cBenchPowerBurstMs  2000
+#define cBenchPowerBurstNum  32
+#define cBenchPowerPhaseStepUs  131 // Shift of each burst against idle sleeps
+
+
+enum {
+    STAGE_VCOPY,
+    STAGE_ENQUEUE,
+    STAGE_DEQUEUE,
+    STAGE_TRANSFORM,
+    STAGE_SUBMIT,
+    STAGE_PIPELINE,
+    // Stages of a device class.  Not in the pipeline.
+    STAGE_DEBOUNCE,
+    STAGE_DEDUP,
+    STAGE_POLL_PHASE,
+    STAGE_COALESCE,
+    STAGE_NUM
+};
+
+static const char *const cStageNameArray[STAGE_NUM] = {
+    "vcopy",
+    "enqueue",
+    "dequeue",
+    "transform",
+    "submit",
+    "pipeline",
+    "debounce",
+    "dedup",
+    "poll_phase",
+    "coalesce",
+};
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} BenchStat;
+
+
+static uint32_t sClockOverhead = 0;
+
+// Substitute of tud_hid_report(): tinyusb copies a report to the endpoint buffer.
+static uint8_t sSubmitBuf[64]; // CFG_TUD_HID_EP_BUFSIZE
+static volatile uint8_t sVCopyBuf[cHidReportBufSize];
+
+static HidReportMap sHidReportMap;
+static HidKernelTable sHidKernelTable;
+static KeyDebounce sKeyDebounce;
+static ReportDedup sReportDedup;
+static PollPhase sPollPhase;
+static MouseCoalesce sMouseCoalesce;
+static volatile uint8_t sOlderBuf[cHidReportBufSize]; // Previous report to merge
+
+static BenchReport sSyntheticReportArray[cBenchSyntheticReportNum];
+#if !PICO_ON_DEVICE
+static BenchReport sRecordedReportArray[2][cBenchRecordedReportMax];
+#endif
+
+
+static void addStat(BenchStat *stat, uint32_t elapsed)
+{
+    elapsed = (elapsed > sClockOverhead) ? (elapsed - sClockOverhead) : 0;
+
+    if (stat->count == 0 || elapsed < stat->min) {
+        stat->min = elapsed;
+    }
+    if (elapsed > stat->max) {
+        stat->max = elapsed;
+    }
+    stat->count += 1;
+    stat->total += elapsed;
+
+    return;
+}
+
+
+static void measureClockOverhead(void)
+{
+    uint32_t min = UINT32_MAX;
+
+    for (size_t i = 0; i < 1000; ++i) {
+        uint32_t start = benchClockNow();
+        uint32_t end = benchClockNow();
+        uint32_t elapsed = benchClockElapsed(start, end);
+        if (elapsed < min) {
+            min = elapsed;
+        }
+    }
+    sClockOverhead = min;
+
+    return;
+}
+
+
+static void submitReport(const volatile uint8_t *report, uint16_t length)
+{
+    if (length > sizeof(sSubmitBuf)) {
+        length = sizeof(sSubmitBuf);
+    }
+    (void)memcpy(sSubmitBuf, (const uint8_t *)report, length);
+
+    return;
+}
+
+
+static void bindKernel(uint8_t deviceType)
+{
+    if (deviceType == BENCH_DEVICE_KEYBOARD) {
+        (void)parseHidReportMap(&sHidReportMap, cBenchKeyboardDescriptor,
+                                cBenchKeyboardDescriptorLength);
+    } else {
+        (void)parseHidReportMap(&sHidReportMap, cBenchMouseDescriptor,
+                                cBenchMouseDescriptorLength);
+    }
+    bindHidKernelTable(&sHidKernelTable, &sHidReportMap);
+
+    bindKeyDebounce(&sKeyDebounce, &sHidReportMap);
+    clearReportDedup(&sReportDedup);
+    initPollPhase(&sPollPhase, cBenchReportIntervalUs);
+    bindMouseCoalesce(&sMouseCoalesce, &sHidReportMap);
+    vZero(sOlderBuf, sizeof(sOlderBuf));
+
+    return;
+}
+
+
+// Stages run only for the device class, in the order of the firmware.
+// The time of the report is mocked.
+static void runClassStages(uint8_t deviceType, uint16_t length, uint32_t nowUs,
+                           BenchStat *statArray)
+{
+    uint32_t t0, t1;
+
+    if (deviceType == BENCH_DEVICE_KEYBOARD) {
+        t0 = benchClockNow();
+        filterKeyDebounce(&sKeyDebounce, sVCopyBuf, length, nowUs);
+        t1 = benchClockNow();
+        addStat(&statArray[STAGE_DEBOUNCE], benchClockElapsed(t0, t1));
+
+        t0 = benchClockNow();
+        if (isDuplicateReport(&sReportDedup, sVCopyBuf, length) == false) {
+            recordReportDedup(&sReportDedup, sVCopyBuf, length);
+        }
+        t1 = benchClockNow();
+        addStat(&statArray[STAGE_DEDUP], benchClockElapsed(t0, t1));
+    } else {
+        t0 = benchClockNow();
+        updatePollPhase(&sPollPhase, nowUs);
+        (void)pollPhaseWaitUs(&sPollPhase, nowUs);
+        t1 = benchClockNow();
+        addStat(&statArray[STAGE_POLL_PHASE], benchClockElapsed(t0, t1));
+
+        t0 = benchClockNow();
+        (void)mergeMouseReport(&sMouseCoalesce, sVCopyBuf, sOlderBuf, length);
+        t1 = benchClockNow();
+        addStat(&statArray[STAGE_COALESCE], benchClockElapsed(t0, t1));
+        vCopy(sOlderBuf, sVCopyBuf, length);
+    }
+
+    return;
+}
+
+
+static void runSet(const BenchReportSet *set, uint32_t passNum, bool *isFirst)
+{
+    BenchStat statArray[STAGE_NUM];
+    (void)memset(statArray, 0, sizeof(statArray));
+
+    reportRingInit();
+    bindKernel(set->deviceType);
+
+    for (uint32_t pass = 0; pass < passNum; ++pass) {
+        for (uint16_t n = 0; n < set->reportNum; ++n) {
+            const BenchReport *src = &set->reportArray[n];
+            volatile uint8_t *report;
+            uint16_t length = 0;
+            uint32_t t0, t1, t2, t3, t4;
+
+            t0 = benchClockNow();
+            vCopy(sVCopyBuf, src->data, src->length);
+            t1 = benchClockNow();
+            addStat(&statArray[STAGE_VCOPY], benchClockElapsed(t0, t1));
+
+            // Stage by stage
+            t0 = benchClockNow();
+            (void)reportRingTryReserve(cBenchInstance);
+            reportRingPush(cBenchInstance, src->data, src->length);
+            t1 = benchClockNow();
+            (void)reportRingTryAcquire(cBenchInstance);
+            report = reportRingPop(cBenchInstance, &length);
+            t2 = benchClockNow();
+            runHidKernel(&sHidKernelTable, report, length);
+            t3 = benchClockNow();
+            submitReport(report, length);
+            reportRingRelease(cBenchInstance);
+            t4 = benchClockNow();
+
+            addStat(&statArray[STAGE_ENQUEUE], benchClockElapsed(t0, t1));
+            addStat(&statArray[STAGE_DEQUEUE], benchClockElapsed(t1, t2));
+            addStat(&statArray[STAGE_TRANSFORM], benchClockElapsed(t2, t3));
+            addStat(&statArray[STAGE_SUBMIT], benchClockElapsed(t3, t4));
+
+            // Whole path in one measurement
+            t0 = benchClockNow();
+            (void)reportRingTryReserve(cBenchInstance);
+            reportRingPush(cBenchInstance, src->data, src->length);
+            (void)reportRingTryAcquire(cBenchInstance);
+            report = reportRingPop(cBenchInstance, &length);
+            runHidKernel(&sHidKernelTable, report, length);
+            submitReport(report, length);
+            reportRingRelease(cBenchInstance);
+            t1 = benchClockNow();
+            addStat(&statArray[STAGE_PIPELINE], benchClockElapsed(t0, t1));
+
+            runClassStages(set->deviceType, src->length,
+                           (pass * set->reportNum + n) * cBenchReportIntervalUs, statArray);
+        }
+    }
+
+    for (size_t stage = 0; stage < STAGE_NUM; ++stage) {
+        const BenchStat *stat = &statArray[stage];
+        if (stat->count == 0) {
+            continue;
+        }
+        uint32_t mean = (stat->count != 0) ? (uint32_t)(stat->total / stat->count) : 0;
+
+        printf("%s\n    {\"set\": \"%s\", \"stage\": \"%s\", \"reports\": %u, "
+               "\"min\": %u, \"mean\": %u, \"max\": %u}",
+               (*isFirst == true) ? "" : ",",
+               set->name, cStageNameArray[stage], (unsigned)stat->count,
+               (unsigned)stat->min, (unsigned)mean, (unsigned)stat->max);
+        *isFirst = false;
+    }
+
+    return;
+}
+
+
+// Replay bursts of input and silence on a mocked clock.
+// A pass sleeps as long as the profile chooses.  Input during the pass
+// leaves the event set, so the sleep is skipped.  Input during the sleep
+// is seen at the later of the timeout and its SEV; an early wake by SEV
+// is not counted on.  Return false if the wake delay exceeds one poll
+// interval (cPowerIdleWaitUs).
+static bool runPowerProfile(void)
+{
+    PowerProfile power;
+    uint32_t nowUs = 0;
+    uint32_t passNum = 0;
+    uint32_t idlePassNum = 0;
+
+    initPowerProfile(&power, nowUs);
+
+    // Bursts start at shifting points of an idle sleep to find the worst one.
+    uint32_t burstUs = 337;
+    for (uint32_t burst = 0; burst < cBenchPowerBurstNum; ++burst) {
+        uint32_t endUs = burstUs + cBenchPowerBurstMs * 1000;
+        uint32_t inputUs = burstUs;
+        uint32_t nextBurstUs = endUs + (uint32_t)POWER_IDLE_MS * 1000 + cBenchPowerBurstMs * 1000 +
+                               cBenchPowerPhaseStepUs;
+
+        while (nowUs < nextBurstUs) {
+            bool isInput = (inputUs < endUs && nowUs >= inputUs);
+            if (isInput == true) {
+                (void)notifyPowerInput(&power, inputUs, nowUs);
+                inputUs += cBenchPowerInputUs;
+            } else {
+                (void)updatePowerProfile(&power, nowUs);
+            }
+
+            if (power.profile == POWER_IDLE) {
+                idlePassNum += 1;
+            }
+            nowUs += cBenchPowerPassUs;
+            passNum += 1;
+
+            // Next input is the first one of the next burst after this one.
+            uint32_t sevUs = (inputUs < endUs) ? inputUs : nextBurstUs;
+            uint32_t waitUs = powerProfileWaitUs(&power);
+            if (waitUs > 0 && sevUs > nowUs) {
+                nowUs += waitUs;
+            }
+        }
+        burstUs = nextBurstUs;
+    }
+
+    bool isPassed = (power.wakeUs <= cPowerIdleWaitUs);
+
+    printf("\n], \"power\": {\"idle_ms\": %u, \"idle_entered\": %u, \"wake_max_us\": %u, "
+           "\"wake_bound_us\": %u, \"passed\": %s, "
+           "\"passes\": %u, \"idle_passes\": %u, \"mock_us\": %u}",
+           (unsigned)POWER_IDLE_MS, (unsigned)power.idleNum, (unsigned)power.wakeUs,
+           (unsigned)cPowerIdleWaitUs, (isPassed == true) ? "true" : "false",
+           (unsigned)passNum, (unsigned)idlePassNum, (unsigned)nowUs);
+
+    return isPassed;
+}
+
+
+#if !PICO_ON_DEVICE
+static bool loadRecordedSet(BenchReportSet *set, BenchReport *reportArray,
+                            const char *path, uint8_t deviceType)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    uint16_t reportNum = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), fp) != NULL && reportNum < cBenchRecordedReportMax) {
+        // Skip comments and usbhid-dump headers.
+        if (line[0] == '#' || strchr(line, ':') != NULL) {
+            continue;
+        }
+        BenchReport *report = &reportArray[reportNum];
+        char *p = line;
+        report->length = 0;
+        while (report->length < cBenchReportSizeMax) {
+            char *end;
+            unsigned long v = strtoul(p, &end, 16);
+            if (end == p) {
+                break;
+            }
+            report->data[report->length++] = (uint8_t)v;
+            p = end;
+        }
+        if (report->length != 0) {
+            reportNum += 1;
+        }
+    }
+    (void)fclose(fp);
+
+    set->name = (deviceType == BENCH_DEVICE_KEYBOARD) ? "keyboard_recorded" : "mouse_recorded";
+    set->deviceType = deviceType;
+    set->reportNum = reportNum;
+    set->reportArray = reportArray;
+
+    return true;
+}
+#endif
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t passNum = cBenchPassNumDefault;
+    BenchReportSet recordedSetArray[2];
+    size_t recordedSetNum = 0;
+
+#if PICO_ON_DEVICE
+    (void)argc;
+    (void)argv;
+
+    stdio_init_all();
+    sleep_ms(1000);
+#else
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            passNum = strtoul(argv[i + 1], NULL, 0);
+        } else if (strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "-m") == 0) {
+            uint8_t deviceType = (argv[i][1] == 'k') ? BENCH_DEVICE_KEYBOARD : BENCH_DEVICE_MOUSE;
+            if (recordedSetNum < ARRAY_NUM(recordedSetArray) &&
+                loadRecordedSet(&recordedSetArray[recordedSetNum],
+                                sRecordedReportArray[recordedSetNum],
+                                argv[i + 1], deviceType) == true) {
+                recordedSetNum += 1;
+            } else {
+                return 1;
+            }
+        }
+    }
+#endif
+
+    benchClockInit();
+    measureClockOverhead();
+
+    printf("{\"clock\": \"%s\", \"unit\": \"%s\", \"clock_hz\": %u, \"overhead\": %u, "
+           "\"passes\": %u, \"results\": [",
+           cBenchClockName, cBenchClockUnit, (unsigned)benchClockHz(),
+           (unsigned)sClockOverhead, (unsigned)passNum);
+
+    bool isFirst = true;
+    {
+        BenchReportSet set;
+
+        benchMakeSyntheticSet(&set, sSyntheticReportArray, ARRAY_NUM(sSyntheticReportArray),
+                              BENCH_DEVICE_KEYBOARD, 0x12345678);
+        runSet(&set, passNum, &isFirst);
+        benchMakeSyntheticSet(&set, sSyntheticReportArray, ARRAY_NUM(sSyntheticReportArray),
+                              BENCH_DEVICE_MOUSE, 0x12345678);
+        runSet(&set, passNum, &isFirst);
+    }
+    runSet(&cBenchKeyboardScriptedSet, passNum, &isFirst);
+    runSet(&cBenchMouseScriptedSet, passNum, &isFirst);
+    for (size_t i = 0; i < recordedSetNum; ++i) {
+        runSet(&recordedSetArray[i], passNum, &isFirst);
+    }
+
+    bool isPowerPassed = runPowerProfile();
+
+    printf("}\n");
+
+#if PICO_ON_DEVICE
+    while (true) {
+        sleep_ms(1000);
+    }
+#endif
+
+    return (isPowerPassed == true) ? 0 : 1;
+}
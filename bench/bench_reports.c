@@ -0,0 +1,159 @@
+#include <stddef.h>
+
+#include "bench_reports.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+#define KEY(mod, ...)  { 8, { (mod), 0x00, __VA_ARGS__ } }
+#define MOUSE(b, x, y, w)  { 4, { (b), (uint8_t)(x), (uint8_t)(y), (uint8_t)(w) } }
+
+
+const uint8_t cBenchKeyboardDescriptor[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,             // Desktop, Keyboard, Application
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, // Modifiers
+    0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,             // Reserved
+    0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01, // LEDs
+    0x29, 0x05, 0x91, 0x02, 0x95, 0x01, 0x75, 0x03,
+    0x91, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, // Keycodes
+    0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+    0xC0,
+};
+const uint16_t cBenchKeyboardDescriptorLength = sizeof(cBenchKeyboardDescriptor);
+
+const uint8_t cBenchMouseDescriptor[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01,             // Desktop, Mouse, Application
+    0x09, 0x01, 0xA1, 0x00,                         // Pointer, Physical
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, // Buttons
+    0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x05, 0x81, 0x01,             // Padding
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x09, 0x38, // X, Y, Wheel
+    0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x03,
+    0x81, 0x06,
+    0xC0, 0xC0,
+};
+const uint16_t cBenchMouseDescriptorLength = sizeof(cBenchMouseDescriptor);
+
+
+static uint32_t nextRandom(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+
+void benchMakeSyntheticSet(BenchReportSet *set, BenchReport *reportArray, uint16_t reportNum,
+                           uint8_t deviceType, uint32_t seed)
+{
+    uint32_t state = (seed != 0) ? seed : 1;
+
+    for (uint16_t n = 0; n < reportNum; ++n) {
+        BenchReport *report = &reportArray[n];
+        for (size_t i = 0; i < ARRAY_NUM(report->data); ++i) {
+            report->data[i] = 0x00;
+        }
+
+        if (deviceType == BENCH_DEVICE_KEYBOARD) {
+            // Boot keyboard: modifiers, reserved, 6 keycodes.
+            // Control and caps appear often to run swap paths.
+            uint32_t r = nextRandom(&state);
+            report->length = 8;
+            report->data[0] = r & 0x13;
+            size_t keyNum = (r >> 8) % 7;
+            for (size_t i = 0; i < keyNum; ++i) {
+                uint32_t k = nextRandom(&state);
+                report->data[2 + i] = ((k & 0x3) == 0) ? 0x39 : (0x04 + k % 0x60);
+            }
+        } else {
+            // Boot mouse + wheel: buttons, x, y, wheel.
+            uint32_t r = nextRandom(&state);
+            report->length = 4;
+            report->data[0] = r & 0x07;
+            report->data[1] = r >> 8;
+            report->data[2] = r >> 16;
+            report->data[3] = ((r >> 24) & 0xF) == 0 ? ((r >> 28) & 1 ? 0x01 : 0xFF) : 0x00;
+        }
+    }
+
+    set->name = (deviceType == BENCH_DEVICE_KEYBOARD) ? "keyboard_synthetic" : "mouse_synthetic";
+    set->deviceType = deviceType;
+    set->reportNum = reportNum;
+    set->reportArray = reportArray;
+
+    return;
+}
+
+
+// Type "Ctrl+C", "Ctrl+V", caps-as-control chords and a 6-key rollover.
+static const BenchReport cKeyboardScriptedArray[] = {
+    KEY(0x00, 0x00),
+    KEY(0x01, 0x00),
+    KEY(0x01, 0x06),
+    KEY(0x01, 0x00),
+    KEY(0x01, 0x19),
+    KEY(0x00, 0x19),
+    KEY(0x00, 0x00),
+    KEY(0x00, 0x39),
+    KEY(0x00, 0x39, 0x06),
+    KEY(0x00, 0x39),
+    KEY(0x00, 0x39, 0x19),
+    KEY(0x00, 0x39),
+    KEY(0x00, 0x00),
+    KEY(0x02, 0x0B),
+    KEY(0x00, 0x0B),
+    KEY(0x00, 0x08),
+    KEY(0x00, 0x0F),
+    KEY(0x00, 0x00),
+    KEY(0x00, 0x0F),
+    KEY(0x00, 0x12),
+    KEY(0x00, 0x00),
+    KEY(0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09),
+    KEY(0x01, 0x04, 0x05, 0x06, 0x07, 0x08),
+    KEY(0x00, 0x04, 0x05, 0x06, 0x07, 0x08, 0x39),
+    KEY(0x00, 0x39),
+    KEY(0x00, 0x00),
+};
+
+const BenchReportSet cBenchKeyboardScriptedSet = {
+    .name = "keyboard_scripted",
+    .deviceType = BENCH_DEVICE_KEYBOARD,
+    .reportNum = ARRAY_NUM(cKeyboardScriptedArray),
+    .reportArray = cKeyboardScriptedArray,
+};
+
+
+// Move, left drag, right click and scroll.
+static const BenchReport cMouseScriptedArray[] = {
+    MOUSE(0x00, 1, 0, 0),
+    MOUSE(0x00, 3, -1, 0),
+    MOUSE(0x00, 8, -2, 0),
+    MOUSE(0x00, 12, -4, 0),
+    MOUSE(0x01, 0, 0, 0),
+    MOUSE(0x01, 5, 2, 0),
+    MOUSE(0x01, 10, 5, 0),
+    MOUSE(0x01, 7, 3, 0),
+    MOUSE(0x00, 0, 0, 0),
+    MOUSE(0x02, 0, 0, 0),
+    MOUSE(0x00, 0, 0, 0),
+    MOUSE(0x00, 0, 0, 1),
+    MOUSE(0x00, 0, 0, 1),
+    MOUSE(0x00, 0, 0, -1),
+    MOUSE(0x00, -20, 15, 0),
+    MOUSE(0x04, 0, 0, 0),
+    MOUSE(0x00, 0, 0, 0),
+};
+
+const BenchReportSet cBenchMouseScriptedSet = {
+    .name = "mouse_scripted",
+    .deviceType = BENCH_DEVICE_MOUSE,
+    .reportNum = ARRAY_NUM(cMouseScriptedArray),
+    .reportArray = cMouseScriptedArray,
+};
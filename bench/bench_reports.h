@@ -0,0 +1,42 @@
+#ifndef BENCH_REPORTS_H
+#define BENCH_REPORTS_H
+
+#include <stdint.h>
+
+
+#define cBenchReportSizeMax  64 // CFG_TUH_HID_EPIN_BUFSIZE
+
+enum {
+    BENCH_DEVICE_MOUSE,
+    BENCH_DEVICE_KEYBOARD,
+};
+
+typedef struct {
+    uint8_t length;
+    uint8_t data[cBenchReportSizeMax];
+} BenchReport;
+
+typedef struct {
+    const char *name;
+    uint8_t deviceType;
+    uint16_t reportNum;
+    const BenchReport *reportArray;
+} BenchReportSet;
+
+
+// Descriptor reports of the devices (boot keyboard, 3-button mouse with wheel)
+extern const uint8_t cBenchKeyboardDescriptor[];
+extern const uint16_t cBenchKeyboardDescriptorLength;
+extern const uint8_t cBenchMouseDescriptor[];
+extern const uint16_t cBenchMouseDescriptorLength;
+
+// Fill a set with pseudo random reports.  Same seed gives same reports.
+void benchMakeSyntheticSet(BenchReportSet *set, BenchReport *reportArray, uint16_t reportNum,
+                           uint8_t deviceType, uint32_t seed);
+
+// Scripted sets (typing with caps/control chords, drag and scroll)
+extern const BenchReportSet cBenchKeyboardScriptedSet;
+extern const BenchReportSet cBenchMouseScriptedSet;
+
+
+#endif /* #ifndef BENCH_REPORTS_H */
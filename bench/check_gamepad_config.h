@@ -0,0 +1,17 @@
+#ifndef CHECK_GAMEPAD_CONFIG_H
+#define CHECK_GAMEPAD_CONFIG_H
+
+// Gamepad remap tables of usbhidproxy_check: Y inverted.
+
+static const GamepadAxisConfig cGamepadAxisConfigArray[] = {
+    { 0x30, false, 0, GAMEPAD_CURVE_LINEAR }, // X
+    { 0x31, true, 0, GAMEPAD_CURVE_LINEAR }, // Y
+};
+
+static const uint8_t cGamepadButtonMap[cGamepadButtonMax] = {
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+};
+
+
+#endif /* #ifndef CHECK_GAMEPAD_CONFIG_H */
@@ -0,0 +1,523 @@
+// Checks of the report path on PC.
+// Each check builds a descriptor report, binds kernels as at mount and
+// runs reports through them.  Exit status is the number of failures.
+//
+// PC: cmake -S bench -B build_bench && cmake --build build_bench
+//     ctest --test-dir build_bench
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "composite_descriptor.h"
+#include "gamepad_remap.h"
+#include "hid_report_map.h"
+#include "hid_transform.h"
+#include "key_debounce.h"
+#include "mouse_coalesce.h"
+#include "report_ring.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+#define CHECK(x)  checkResult((x), #x, __func__, __LINE__)
+
+
+static HidReportMap sHidReportMap;
+static uint32_t sFailureNum = 0;
+
+
+static void checkResult(bool isPassed, const char *expression, const char *func, int line)
+{
+    if (isPassed == false) {
+        printf("FAIL %s:%d: %s\n", func, line, expression);
+        sFailureNum += 1;
+    }
+
+    return;
+}
+
+
+static uint16_t readU16(const uint8_t *report, size_t offset)
+{
+    return report[offset] | (report[offset + 1] << 8);
+}
+
+
+// 16-bit unsigned axes.  Logical Maximum 65535 comes in 2 bytes as 0xFFFF.
+static void checkGamepadAxisRange16(void)
+{
+    static const uint8_t cDescriptor[] = {
+        0x05, 0x01, // Usage Page (Generic Desktop)
+        0x09, 0x05, // Usage (Gamepad)
+        0xA1, 0x01, // Collection (Application)
+        0x09, 0x30, //   Usage (X)
+        0x09, 0x31, //   Usage (Y)
+        0x15, 0x00, //   Logical Minimum (0)
+        0x26, 0xFF, 0xFF, //   Logical Maximum (65535)
+        0x75, 0x10, //   Report Size (16)
+        0x95, 0x02, //   Report Count (2)
+        0x81, 0x02, //   Input (Data, Variable, Absolute)
+        0xC0, // End Collection
+    };
+
+    CHECK(parseHidReportMap(&sHidReportMap, cDescriptor, sizeof(cDescriptor)) == true);
+    const HidReportLayout *layout = findHidReportLayout(&sHidReportMap, 0);
+    CHECK(layout != NULL && layout->axisNum == 2);
+    if (layout == NULL || layout->axisNum != 2) {
+        return;
+    }
+    CHECK(layout->axisArray[1].logicalMin == 0);
+    CHECK(layout->axisArray[1].logicalMax == 65535);
+
+    HidKernel kernel;
+    (void)memset(&kernel, 0, sizeof(kernel));
+    CHECK(bindGamepadKernel(&kernel, layout) == true);
+    if (kernel.func == NULL) {
+        return;
+    }
+
+    // Y centered, at both ends.  The curve table is off by a few counts at the ends.
+    static const uint16_t cInArray[] = { 32768, 0, 65535 };
+    static const uint16_t cOutArray[] = { 32768, 65535, 0 };
+    for (size_t i = 0; i < ARRAY_NUM(cInArray); ++i) {
+        uint8_t report[4] = {
+            0x00, 0x80, // X
+            cInArray[i] & 0xFF, cInArray[i] >> 8,
+        };
+        kernel.func(report, sizeof(report), &kernel.param);
+        int32_t error = (int32_t)readU16(report, 2) - cOutArray[i];
+        CHECK(readU16(report, 0) == 32768);
+        CHECK(error >= -4 && error <= 4);
+    }
+
+    releaseGamepadKernel(&kernel);
+
+    return;
+}
+
+
+// The config of the checks has X and Y only.  Z is passed as it is.
+static void checkGamepadAxisNotConfigured(void)
+{
+    static const uint8_t cDescriptor[] = {
+        0x05, 0x01, // Usage Page (Generic Desktop)
+        0x09, 0x05, // Usage (Gamepad)
+        0xA1, 0x01, // Collection (Application)
+        0x09, 0x30, //   Usage (X)
+        0x09, 0x31, //   Usage (Y)
+        0x09, 0x32, //   Usage (Z)
+        0x15, 0x00, //   Logical Minimum (0)
+        0x26, 0xFF, 0x00, //   Logical Maximum (255)
+        0x75, 0x08, //   Report Size (8)
+        0x95, 0x03, //   Report Count (3)
+        0x81, 0x02, //   Input (Data, Variable, Absolute)
+        0xC0, // End Collection
+    };
+
+    CHECK(parseHidReportMap(&sHidReportMap, cDescriptor, sizeof(cDescriptor)) == true);
+    const HidReportLayout *layout = findHidReportLayout(&sHidReportMap, 0);
+    CHECK(layout != NULL && layout->axisNum == 3);
+    if (layout == NULL) {
+        return;
+    }
+
+    HidKernel kernel;
+    (void)memset(&kernel, 0, sizeof(kernel));
+    CHECK(bindGamepadKernel(&kernel, layout) == true);
+    if (kernel.func == NULL) {
+        return;
+    }
+
+    uint8_t report[3] = { 0x80, 0x00, 0x12 };
+    kernel.func(report, sizeof(report), &kernel.param);
+    CHECK(report[0] == 0x80);
+    CHECK(report[1] >= 0xFC); // Inverted
+    CHECK(report[2] == 0x12);
+
+    releaseGamepadKernel(&kernel);
+
+    return;
+}
+
+
+// Boot keyboard: modifiers, reserved and 6 keycodes
+static const uint8_t cBootKeyboardDescriptor[] = {
+    0x05, 0x01, // Usage Page (Generic Desktop)
+    0x09, 0x06, // Usage (Keyboard)
+    0xA1, 0x01, // Collection (Application)
+    0x05, 0x07, //   Usage Page (Keyboard)
+    0x19, 0xE0, //   Usage Minimum (Left Control)
+    0x29, 0xE7, //   Usage Maximum (Right GUI)
+    0x15, 0x00, //   Logical Minimum (0)
+    0x25, 0x01, //   Logical Maximum (1)
+    0x75, 0x01, //   Report Size (1)
+    0x95, 0x08, //   Report Count (8)
+    0x81, 0x02, //   Input (Data, Variable, Absolute)
+    0x75, 0x08, //   Report Size (8)
+    0x95, 0x01, //   Report Count (1)
+    0x81, 0x01, //   Input (Constant)
+    0x19, 0x00, //   Usage Minimum (0)
+    0x29, 0x65, //   Usage Maximum (101)
+    0x25, 0x65, //   Logical Maximum (101)
+    0x95, 0x06, //   Report Count (6)
+    0x81, 0x00, //   Input (Data, Array)
+    0xC0, // End Collection
+};
+
+// NKRO keyboard: modifiers and a bitmap of keycodes 0 to 103
+static const uint8_t cNkroKeyboardDescriptor[] = {
+    0x05, 0x01, // Usage Page (Generic Desktop)
+    0x09, 0x06, // Usage (Keyboard)
+    0xA1, 0x01, // Collection (Application)
+    0x05, 0x07, //   Usage Page (Keyboard)
+    0x19, 0xE0, //   Usage Minimum (Left Control)
+    0x29, 0xE7, //   Usage Maximum (Right GUI)
+    0x15, 0x00, //   Logical Minimum (0)
+    0x25, 0x01, //   Logical Maximum (1)
+    0x75, 0x01, //   Report Size (1)
+    0x95, 0x08, //   Report Count (8)
+    0x81, 0x02, //   Input (Data, Variable, Absolute)
+    0x19, 0x00, //   Usage Minimum (0)
+    0x29, 0x67, //   Usage Maximum (103)
+    0x95, 0x68, //   Report Count (104)
+    0x81, 0x02, //   Input (Data, Variable, Absolute)
+    0xC0, // End Collection
+};
+
+#define cNkroReportSize  (1 + 104 / 8)
+
+
+static bool bindCheckKeyDebounce(KeyDebounce *debounce, const uint8_t *descriptor, uint16_t length)
+{
+    CHECK(parseHidReportMap(&sHidReportMap, descriptor, length) == true);
+    bindKeyDebounce(debounce, &sHidReportMap);
+    CHECK(debounce->isEnabled == true);
+
+    return debounce->isEnabled;
+}
+
+
+static void setNkroKey(uint8_t *report, uint8_t key, bool isPushed)
+{
+    uint16_t bit = 8 + key;
+    if (isPushed == true) {
+        report[bit / 8] |= 1 << (bit % 8);
+    } else {
+        report[bit / 8] &= ~(1 << (bit % 8));
+    }
+
+    return;
+}
+
+
+static bool testNkroKey(const uint8_t *report, uint8_t key)
+{
+    uint16_t bit = 8 + key;
+
+    return (report[bit / 8] >> (bit % 8)) & 1;
+}
+
+
+// First edge at once, bounce dropped, settled after the window.
+static void checkKeyDebounceArray(void)
+{
+    static KeyDebounce debounce;
+    uint8_t settle[cKeyDebounceReportMax];
+    uint16_t settleLength = 0;
+
+    if (bindCheckKeyDebounce(&debounce, cBootKeyboardDescriptor, sizeof(cBootKeyboardDescriptor)) == false) {
+        return;
+    }
+    CHECK(debounce.keyArrayNum == 6 && debounce.keyArrayOffset == 2);
+
+    // A pushed at 0 passes at once.
+    uint8_t report[8] = { 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    filterKeyDebounce(&debounce, report, sizeof(report), 0);
+    CHECK(report[2] == 0x04);
+
+    // Released by a bounce at 1 ms.  Dropped.
+    uint8_t bounce[8] = { 0 };
+    filterKeyDebounce(&debounce, bounce, sizeof(bounce), 1000);
+    CHECK(bounce[2] == 0x04);
+
+    // B pushed meanwhile passes at once.  A is still held.
+    uint8_t other[8] = { 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    filterKeyDebounce(&debounce, other, sizeof(other), 2000);
+    CHECK(other[2] == 0x05 && other[3] == 0x04);
+
+    // A stays released.  Settled after the window of A.
+    CHECK(makeKeyDebounceReport(&debounce, settle, &settleLength, 4999) == false);
+    CHECK(makeKeyDebounceReport(&debounce, settle, &settleLength, 5000) == true);
+    CHECK(settleLength == sizeof(report));
+    CHECK(settle[2] == 0x05 && settle[3] == 0x00);
+    CHECK(makeKeyDebounceReport(&debounce, settle, &settleLength, 6000) == false);
+
+    // The settle is an edge of A.  A pushed again after its window passes at once.
+    uint8_t again[8] = { 0x00, 0x00, 0x05, 0x04, 0x00, 0x00, 0x00, 0x00 };
+    filterKeyDebounce(&debounce, again, sizeof(again), 10000);
+    CHECK(again[2] == 0x05 && again[3] == 0x04);
+
+    return;
+}
+
+
+// NKRO bitmap, and more keys in the window than entries.
+static void checkKeyDebounceBitmap(void)
+{
+    static KeyDebounce debounce;
+    enum { cKeyFirst = 0x04, cKeyNum = cKeyDebounceEntryMax + 4 };
+    uint8_t raw[cNkroReportSize] = { 0 };
+    uint8_t report[cNkroReportSize];
+
+    if (bindCheckKeyDebounce(&debounce, cNkroKeyboardDescriptor, sizeof(cNkroKeyboardDescriptor)) == false) {
+        return;
+    }
+    CHECK(debounce.keyArrayNum == 0 && debounce.keyBitmapBit == 8 && debounce.keyBitmapNum == 104);
+
+    // One more key every 0.1 ms.  Every first edge passes.
+    for (uint8_t i = 0; i < cKeyNum; ++i) {
+        setNkroKey(raw, cKeyFirst + i, true);
+        (void)memcpy(report, raw, sizeof(report));
+        filterKeyDebounce(&debounce, report, sizeof(report), i * 100);
+        CHECK(memcmp(report, raw, sizeof(report)) == 0);
+    }
+    CHECK(debounce.entryNum == cKeyDebounceEntryMax);
+
+    // Bounce of the last key is dropped.  Entries of the oldest keys were reused.
+    uint8_t lastKey = cKeyFirst + cKeyNum - 1;
+    setNkroKey(raw, lastKey, false);
+    (void)memcpy(report, raw, sizeof(report));
+    filterKeyDebounce(&debounce, report, sizeof(report), cKeyNum * 100);
+    CHECK(testNkroKey(report, lastKey) == true);
+    CHECK(testNkroKey(report, cKeyFirst) == true);
+
+    // Settled after the window of the last key.
+    uint16_t length = 0;
+    uint32_t settleUs = (cKeyNum - 1) * 100 + KEY_DEBOUNCE_WINDOW_US;
+    CHECK(makeKeyDebounceReport(&debounce, report, &length, settleUs - 1) == false);
+    CHECK(makeKeyDebounceReport(&debounce, report, &length, settleUs) == true);
+    CHECK(length == sizeof(report) && testNkroKey(report, lastKey) == false);
+    CHECK(testNkroKey(report, cKeyFirst) == true);
+
+    return;
+}
+
+
+// Two same reports of a relative field are two steps, not a duplicate.
+static void checkRelativeNotDedup(void)
+{
+    static const uint8_t cDescriptor[] = {
+        0x05, 0x0C, // Usage Page (Consumer)
+        0x09, 0x01, // Usage (Consumer Control)
+        0xA1, 0x01, // Collection (Application)
+        0x85, 0x01, //   Report ID (1)
+        0x09, 0xE9, //   Usage (Volume Increment)
+        0x09, 0xEA, //   Usage (Volume Decrement)
+        0x15, 0x00, //   Logical Minimum (0)
+        0x25, 0x01, //   Logical Maximum (1)
+        0x75, 0x01, //   Report Size (1)
+        0x95, 0x02, //   Report Count (2)
+        0x81, 0x02, //   Input (Data, Variable, Absolute)
+        0x95, 0x06, //   Report Count (6)
+        0x81, 0x01, //   Input (Constant)
+        0x85, 0x02, //   Report ID (2)
+        0x0A, 0x38, 0x02, //   Usage (AC Pan)
+        0x15, 0x81, //   Logical Minimum (-127)
+        0x25, 0x7F, //   Logical Maximum (127)
+        0x75, 0x08, //   Report Size (8)
+        0x95, 0x01, //   Report Count (1)
+        0x81, 0x06, //   Input (Data, Variable, Relative)
+        0xC0, // End Collection
+    };
+    static HidKernelTable table;
+
+    CHECK(parseHidReportMap(&sHidReportMap, cDescriptor, sizeof(cDescriptor)) == true);
+    const HidReportLayout *layout = findHidReportLayout(&sHidReportMap, 2);
+    CHECK(layout != NULL && layout->hasRelative == true);
+    CHECK(layout != NULL && layout->axisNum == 1 && layout->axisArray[0].isRelative == true);
+
+    bindHidKernelTable(&table, &sHidReportMap);
+    CHECK((table.dedupMask & (1 << 1)) != 0);
+    CHECK((table.dedupMask & (1 << 2)) == 0);
+    clearHidKernelTable(&table);
+
+    return;
+}
+
+
+// Absolute X/Y with a signed range (tablets, VMs) are not summed.
+// Only the relative wheel is.
+static void checkMouseCoalesceRelativeOnly(void)
+{
+    static const uint8_t cDescriptor[] = {
+        0x05, 0x01, // Usage Page (Generic Desktop)
+        0x09, 0x02, // Usage (Mouse)
+        0xA1, 0x01, // Collection (Application)
+        0x09, 0x01, //   Usage (Pointer)
+        0xA1, 0x00, //   Collection (Physical)
+        0x09, 0x30, //     Usage (X)
+        0x09, 0x31, //     Usage (Y)
+        0x16, 0x01, 0x80, //     Logical Minimum (-32767)
+        0x26, 0xFF, 0x7F, //     Logical Maximum (32767)
+        0x75, 0x10, //     Report Size (16)
+        0x95, 0x02, //     Report Count (2)
+        0x81, 0x02, //     Input (Data, Variable, Absolute)
+        0x09, 0x38, //     Usage (Wheel)
+        0x15, 0x81, //     Logical Minimum (-127)
+        0x25, 0x7F, //     Logical Maximum (127)
+        0x75, 0x08, //     Report Size (8)
+        0x95, 0x01, //     Report Count (1)
+        0x81, 0x06, //     Input (Data, Variable, Relative)
+        0xC0, //   End Collection
+        0xC0, // End Collection
+    };
+    static MouseCoalesce coalesce;
+
+    CHECK(parseHidReportMap(&sHidReportMap, cDescriptor, sizeof(cDescriptor)) == true);
+    bindMouseCoalesce(&coalesce, &sHidReportMap);
+    CHECK(coalesce.layoutNum == 1);
+    if (coalesce.layoutNum != 1) {
+        return;
+    }
+    CHECK(coalesce.layoutArray[0].axisNum == 1);
+    CHECK(coalesce.layoutArray[0].axisArray[0].bit == 32);
+
+    // X/Y at the same position, wheel steps 1 and 2.
+    uint8_t older[5] = { 0x10, 0x00, 0x20, 0x00, 0x01 };
+    uint8_t newer[5] = { 0x10, 0x00, 0x20, 0x00, 0x02 };
+    CHECK(mergeMouseReport(&coalesce, newer, older, sizeof(newer)) == true);
+    CHECK(newer[0] == 0x10 && newer[2] == 0x20 && newer[4] == 0x03);
+
+    // X moved.  Absolute positions are not merged.
+    uint8_t moved[5] = { 0x11, 0x00, 0x20, 0x00, 0x01 };
+    CHECK(mergeMouseReport(&coalesce, moved, older, sizeof(moved)) == false);
+
+    return;
+}
+
+
+// Completion of a report sent before the ring was shrunk comes late.
+// It must not free more slots than the depth.
+static void checkRingStaleRelease(void)
+{
+    static const uint8_t cReport[1] = { 0 };
+    uint16_t length;
+
+    reportRingInit();
+    CHECK(reportRingTryReserve(0) == true);
+    reportRingPush(0, cReport, sizeof(cReport));
+    CHECK(reportRingTryAcquire(0) == true);
+    (void)reportRingPop(0, &length);
+
+    // Remounted as a smaller class while the report is in flight.
+    reportRingSetDepth(0, 2);
+    reportRingRelease(0);
+
+    uint32_t n = 0;
+    while (reportRingTryReserve(0) == true) {
+        reportRingPush(0, cReport, sizeof(cReport));
+        n += 1;
+    }
+    CHECK(n == 2);
+    CHECK(reportRingQueuedNum(0) == 2);
+
+    return;
+}
+
+
+// PC reads wDescriptorLength bytes of the descriptor report.  Only the
+// bytes kept may be advertised.
+static void checkHidReportLengthClamped(void)
+{
+    static const uint8_t cConfiguration[] = {
+        0x09, 0x02, 0x22, 0x00, 0x01, 0x01, 0x00, 0xA0, 0x32, // Configuration
+        0x09, 0x04, 0x00, 0x00, 0x01, 0x03, 0x01, 0x02, 0x00, // Interface (HID, mouse)
+        0x09, 0x21, 0x11, 0x01, 0x00, 0x01, 0x22, 0x2C, 0x01, // HID (report 300 bytes)
+        0x07, 0x05, 0x81, 0x03, 0x08, 0x00, 0x01, // Endpoint IN 1, interrupt
+    };
+    HidInterfaceDescriptor descriptor;
+
+    CHECK(findHidInterface(cConfiguration, sizeof(cConfiguration), 0, 256, descriptor) == true);
+    CHECK(readU16(descriptor, 9 + 7) == 256);
+    CHECK(findHidInterface(cConfiguration, sizeof(cConfiguration), 0, 1024, descriptor) == true);
+    CHECK(readU16(descriptor, 9 + 7) == 300);
+
+    return;
+}
+
+
+// Fields after Pop are placed by the global state before Push.
+static void checkGlobalPushPop(void)
+{
+    static const uint8_t cDescriptor[] = {
+        0x05, 0x01, // Usage Page (Generic Desktop)
+        0x09, 0x04, // Usage (Joystick)
+        0xA1, 0x01, // Collection (Application)
+        0x15, 0x81, //   Logical Minimum (-127)
+        0x25, 0x7F, //   Logical Maximum (127)
+        0x75, 0x08, //   Report Size (8)
+        0x95, 0x02, //   Report Count (2)
+        0x09, 0x30, //   Usage (X)
+        0x09, 0x31, //   Usage (Y)
+        0x81, 0x02, //   Input (Data, Variable, Absolute)
+        0xA4, //   Push
+        0x09, 0x39, //   Usage (Hat switch)
+        0x15, 0x00, //   Logical Minimum (0)
+        0x25, 0x07, //   Logical Maximum (7)
+        0x75, 0x04, //   Report Size (4)
+        0x95, 0x01, //   Report Count (1)
+        0x81, 0x42, //   Input (Data, Variable, Absolute, Null State)
+        0x05, 0x09, //   Usage Page (Button)
+        0x19, 0x01, //   Usage Minimum (1)
+        0x29, 0x04, //   Usage Maximum (4)
+        0x25, 0x01, //   Logical Maximum (1)
+        0x75, 0x01, //   Report Size (1)
+        0x95, 0x04, //   Report Count (4)
+        0x81, 0x02, //   Input (Data, Variable, Absolute)
+        0xB4, //   Pop
+        0x09, 0x32, //   Usage (Z)
+        0x09, 0x35, //   Usage (Rz)
+        0x81, 0x02, //   Input (Data, Variable, Absolute)
+        0xC0, // End Collection
+    };
+    static const uint8_t cUnbalanced[] = {
+        0x05, 0x01, // Usage Page (Generic Desktop)
+        0xB4, // Pop
+    };
+
+    CHECK(parseHidReportMap(&sHidReportMap, cDescriptor, sizeof(cDescriptor)) == true);
+    const HidReportLayout *layout = findHidReportLayout(&sHidReportMap, 0);
+    CHECK(layout != NULL && layout->axisNum == 4);
+    if (layout == NULL || layout->axisNum != 4) {
+        return;
+    }
+    CHECK(layout->hat.bit == 16 && layout->hat.size == 4);
+    CHECK(layout->button.bit == 20 && layout->buttonNum == 4);
+    CHECK(layout->axisArray[2].usage == 0x32 && layout->axisArray[2].bit == 24);
+    CHECK(layout->axisArray[2].size == 8 && layout->axisArray[2].logicalMin == -127);
+    CHECK(layout->axisArray[3].bit == 32);
+    CHECK(layout->bitLength == 40);
+
+    CHECK(parseHidReportMap(&sHidReportMap, cUnbalanced, sizeof(cUnbalanced)) == false);
+
+    return;
+}
+
+
+int main(void)
+{
+    checkGamepadAxisRange16();
+    checkGamepadAxisNotConfigured();
+    checkKeyDebounceArray();
+    checkKeyDebounceBitmap();
+    checkRelativeNotDedup();
+    checkMouseCoalesceRelativeOnly();
+    checkRingStaleRelease();
+    checkHidReportLengthClamped();
+    checkGlobalPushPop();
+
+    printf("%u failures\n", (unsigned)sFailureNum);
+
+    return (sFailureNum == 0) ? 0 : 1;
+}
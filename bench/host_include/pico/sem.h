@@ -0,0 +1,48 @@
+#ifndef _PICO_SEM_H
+#define _PICO_SEM_H
+
+// Single thread substitute of pico_sync semaphore for the PC build of bench.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    int16_t permits;
+    int16_t max_permits;
+} semaphore_t;
+
+static inline void sem_init(semaphore_t *sem, int16_t initial_permits, int16_t max_permits)
+{
+    sem->permits = initial_permits;
+    sem->max_permits = max_permits;
+}
+
+static inline bool sem_try_acquire(semaphore_t *sem)
+{
+    if (sem->permits <= 0) {
+        return false;
+    }
+    sem->permits -= 1;
+    return true;
+}
+
+static inline bool sem_release(semaphore_t *sem)
+{
+    if (sem->permits >= sem->max_permits) {
+        return false;
+    }
+    sem->permits += 1;
+    return true;
+}
+
+static inline void sem_reset(semaphore_t *sem, int16_t permits)
+{
+    sem->permits = permits;
+}
+
+static inline int sem_available(semaphore_t *sem)
+{
+    return sem->permits;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef SIZING_H
+#define SIZING_H
+
+
+// Buffer sizes and queue depths of the build.
+// cmake -DSIZING_PROFILE=<default|gaming|composite|minimal> .. defines
+// the macros below from the profile.  Each one can be overridden alone,
+// e.g. cmake -DSIZING_PROFILE=minimal -DREPORT_RING_DEPTH_MOUSE=8 ..
+// Values here are the default profile.
+
+// HID interfaces proxied in total.
+// One IN endpoint each, and RP2040 device has 15 IN endpoints.
+#ifndef HID_INSTANCE_MAX
+#define HID_INSTANCE_MAX  8
+#endif
+
+// Bytes of a report slot.  A report is not longer than the IN endpoint
+// buffer of the host (CFG_TUH_HID_EPIN_BUFSIZE), which holds max packet
+// size of low/full-speed interrupt endpoints.
+#ifndef REPORT_RING_SLOT_SIZE
+#define REPORT_RING_SLOT_SIZE  64
+#endif
+
+// Reports queued per instance by device class.
+// A full ring makes core1 wait while PC takes reports, so keep keyboards
+// deep enough not to drop keys.  Mouse reports are merged while queued.
+// Only the latest gamepad state matters.
+#ifndef REPORT_RING_DEPTH_MOUSE
+#define REPORT_RING_DEPTH_MOUSE  8
+#endif
+#ifndef REPORT_RING_DEPTH_KEYBOARD
+#define REPORT_RING_DEPTH_KEYBOARD  8
+#endif
+#ifndef REPORT_RING_DEPTH_GAMEPAD
+#define REPORT_RING_DEPTH_GAMEPAD  4
+#endif
+#ifndef REPORT_RING_DEPTH_OTHER
+#define REPORT_RING_DEPTH_OTHER  4
+#endif
+
+// Bytes of a descriptor report kept per instance.
+#ifndef DESCRIPTOR_REPORT_BUF_SIZE
+#define DESCRIPTOR_REPORT_BUF_SIZE  0x1000
+#endif
+
+// Bytes the buffers above may take.  Checked at build time.
+#ifndef SIZING_RAM_BUDGET
+#define SIZING_RAM_BUDGET  (64 * 1024)
+#endif
+
+
+#define SIZING_MAX_(a, b)  (((a) > (b)) ? (a) : (b))
+
+// Slots allocated per instance.  Depth of each class is limited at mount.
+#define REPORT_RING_DEPTH_MAX \
+    SIZING_MAX_(SIZING_MAX_(REPORT_RING_DEPTH_MOUSE, REPORT_RING_DEPTH_KEYBOARD), \
+                SIZING_MAX_(REPORT_RING_DEPTH_GAMEPAD, REPORT_RING_DEPTH_OTHER))
+
+// Report, length and sequence number per slot
+#define SIZING_REPORT_RING_BYTES \
+    (HID_INSTANCE_MAX * REPORT_RING_DEPTH_MAX * (REPORT_RING_SLOT_SIZE + 2 + 4))
+#define SIZING_DESCRIPTOR_REPORT_BYTES  (HID_INSTANCE_MAX * DESCRIPTOR_REPORT_BUF_SIZE)
+#define SIZING_RAM_BYTES  (SIZING_REPORT_RING_BYTES + SIZING_DESCRIPTOR_REPORT_BYTES)
+
+
+#if HID_INSTANCE_MAX < 1 || HID_INSTANCE_MAX > 15
+#error HID_INSTANCE_MAX must be 1 to 15
+#endif
+
+#if REPORT_RING_DEPTH_MOUSE < 1 || REPORT_RING_DEPTH_KEYBOARD < 1 || \
+    REPORT_RING_DEPTH_GAMEPAD < 1 || REPORT_RING_DEPTH_OTHER < 1
+#error REPORT_RING_DEPTH_* must be 1 or more
+#endif
+
+#if REPORT_RING_DEPTH_MAX > 255
+#error REPORT_RING_DEPTH_* must be 255 or less
+#endif
+
+#if SIZING_RAM_BYTES > SIZING_RAM_BUDGET
+#error Buffers exceed SIZING_RAM_BUDGET.  Reduce instances, depths or buffer sizes.
+#endif
+
+
+#endif /* #ifndef SIZING_H */
@@ -5,7 +5,7 @@
 extern "C" {
 #endif
 
-#define HID_INSTANCE_MAX  8
+#include "sizing.h"
 
 #ifndef BOARD_TUD_RHPORT
 #define BOARD_TUD_RHPORT  0
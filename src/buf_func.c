@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#include "buf_func.h"
+
+
+void vCopy(volatile void *restrict dst,
+           volatile const void *restrict src,
+           size_t n)
+{
+    volatile uint8_t *d = dst;
+    const volatile uint8_t *s = src;
+
+    for (size_t i = 0; i < n; ++i) {
+        *d++ = *s++;
+    }
+
+    return;
+}
+
+
+void vZero(volatile void *restrict dst, size_t n)
+{
+    volatile uint8_t *d = dst;
+    for (size_t i = 0; i < n; ++i) {
+        *d++ = 0;
+    }
+
+    return;
+}
+
+
+uint32_t readBits(const volatile uint8_t *report, uint16_t bit, uint8_t size)
+{
+    uint64_t v = 0;
+    uint16_t byte = bit / 8;
+    uint8_t shift = bit % 8;
+    uint8_t byteNum = (shift + size + 7) / 8;
+
+    for (uint8_t i = 0; i < byteNum; ++i) {
+        v |= (uint64_t)report[byte + i] << (8 * i);
+    }
+    v >>= shift;
+    if (size < 32) {
+        v &= (1u << size) - 1;
+    }
+
+    return (uint32_t)v;
+}
+
+
+void writeBits(volatile uint8_t *report, uint16_t bit, uint8_t size, uint32_t v)
+{
+    uint16_t byte = bit / 8;
+    uint8_t shift = bit % 8;
+    uint8_t byteNum = (shift + size + 7) / 8;
+    uint64_t mask = ((size < 32) ? ((1ull << size) - 1) : 0xFFFFFFFFull) << shift;
+    uint64_t data = (uint64_t)v << shift;
+
+    for (uint8_t i = 0; i < byteNum; ++i) {
+        uint8_t m = mask >> (8 * i);
+        report[byte + i] = (report[byte + i] & ~m) | ((data >> (8 * i)) & m);
+    }
+
+    return;
+}
@@ -0,0 +1,19 @@
+#ifndef BUF_FUNC_H
+#define BUF_FUNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+void vCopy(volatile void *restrict dst,
+           volatile const void *restrict src,
+           size_t n);
+
+void vZero(volatile void *restrict dst, size_t n);
+
+// Field of a report at bit (LSB first), size bits (<= 32)
+uint32_t readBits(const volatile uint8_t *report, uint16_t bit, uint8_t size);
+
+void writeBits(volatile uint8_t *report, uint16_t bit, uint8_t size, uint32_t v);
+
+#endif /* #ifndef BUF_FUNC_H */
@@ -0,0 +1,129 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "composite_descriptor.h"
+
+
+// USB 2.0 9.4 and HID 1.11 6.2.1
+enum {
+    DESCRIPTOR_INTERFACE = 0x04,
+    DESCRIPTOR_ENDPOINT = 0x05,
+    DESCRIPTOR_HID = 0x21,
+};
+
+#define cInterfaceClassHid  0x03
+#define cEndpointIn  0x80
+#define cEndpointInterrupt  0x03
+
+#define cInterfaceSize  9
+#define cHidSize  9
+#define cEndpointSize  7
+
+// Offsets in HidInterfaceDescriptor
+#define cHidOffset  cInterfaceSize
+#define cEndpointOffset  (cInterfaceSize + cHidSize)
+
+
+static bool isHidInterface(const uint8_t *p)
+{
+    return p[0] >= cInterfaceSize && p[1] == DESCRIPTOR_INTERFACE &&
+           p[3] == 0 && p[5] == cInterfaceClassHid;
+}
+
+
+uint8_t countHidInterfaces(const uint8_t *configuration, uint16_t length)
+{
+    uint8_t n = 0;
+
+    for (uint16_t pos = 0; pos + 2 <= length && configuration[pos] != 0; pos += configuration[pos]) {
+        if (pos + cInterfaceSize <= length && isHidInterface(&configuration[pos]) == true) {
+            n += 1;
+        }
+    }
+
+    return n;
+}
+
+
+bool findHidInterface(const uint8_t *configuration, uint16_t length,
+                      uint8_t ordinal, uint16_t reportLengthMax,
+                      HidInterfaceDescriptor descriptor)
+{
+    uint8_t n = 0;
+    bool isInside = false;
+    bool hasHid = false;
+
+    for (uint16_t pos = 0; pos + 2 <= length && configuration[pos] != 0; pos += configuration[pos]) {
+        const uint8_t *p = &configuration[pos];
+        const uint8_t size = p[0];
+        if (pos + size > length) {
+            break;
+        }
+
+        if (p[1] == DESCRIPTOR_INTERFACE) {
+            if (isInside == true) {
+                break; // No endpoint IN
+            }
+            if (size >= cInterfaceSize && isHidInterface(p) == true) {
+                if (n == ordinal) {
+                    (void)memcpy(descriptor, p, cInterfaceSize);
+                    isInside = true;
+                }
+                n += 1;
+            }
+        } else if (isInside == true && p[1] == DESCRIPTOR_HID && size >= cHidSize && hasHid == false) {
+            // Only the first class descriptor (report) is kept.
+            (void)memcpy(&descriptor[cHidOffset], p, cHidSize);
+            descriptor[cHidOffset] = cHidSize;
+            descriptor[cHidOffset + 5] = 1; // bNumDescriptors
+            {
+                // PC must not read past the kept descriptor report.
+                uint16_t reportLength = descriptor[cHidOffset + 7] | (descriptor[cHidOffset + 8] << 8);
+                if (reportLength > reportLengthMax) {
+                    descriptor[cHidOffset + 7] = reportLengthMax & 0xFF; // wDescriptorLength
+                    descriptor[cHidOffset + 8] = reportLengthMax >> 8;
+                }
+            }
+            hasHid = true;
+        } else if (isInside == true && p[1] == DESCRIPTOR_ENDPOINT && size >= cEndpointSize &&
+                   (p[2] & cEndpointIn) != 0 && (p[3] & 0x03) == cEndpointInterrupt) {
+            (void)memcpy(&descriptor[cEndpointOffset], p, cEndpointSize);
+            descriptor[cEndpointOffset] = cEndpointSize;
+            return hasHid;
+        }
+    }
+
+    return false;
+}
+
+
+uint16_t buildCompositeConfiguration(uint8_t *configuration, uint16_t size,
+                                     const uint8_t *header, uint8_t attributes, uint8_t maxPower,
+                                     const HidInterfaceDescriptor *interfaceArray,
+                                     const uint8_t *stringIndexArray, uint8_t interfaceNum)
+{
+    const uint16_t length = cConfigurationHeaderSize + cHidInterfaceDescriptorSize * interfaceNum;
+    if (length > size) {
+        return 0;
+    }
+
+    (void)memcpy(configuration, header, cConfigurationHeaderSize);
+    configuration[2] = length & 0xFF; // wTotalLength
+    configuration[3] = length >> 8;
+    configuration[4] = interfaceNum; // bNumInterfaces
+    configuration[7] = attributes; // bmAttributes
+    configuration[8] = maxPower; // bMaxPower
+
+    for (uint8_t i = 0; i < interfaceNum; ++i) {
+        uint8_t *p = &configuration[cConfigurationHeaderSize + cHidInterfaceDescriptorSize * i];
+        (void)memcpy(p, interfaceArray[i], cHidInterfaceDescriptorSize);
+        p[0] = cInterfaceSize;
+        p[2] = i; // bInterfaceNumber
+        p[3] = 0; // bAlternateSetting
+        p[4] = 1; // bNumEndpoints
+        p[8] = stringIndexArray[i]; // iInterface
+        p[cEndpointOffset + 2] = cEndpointIn | (i + 1); // bEndpointAddress
+    }
+
+    return length;
+}
@@ -0,0 +1,36 @@
+#ifndef COMPOSITE_DESCRIPTOR_H
+#define COMPOSITE_DESCRIPTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Composite configuration made of HID interfaces of downstream devices.
+// Each HID interface is reduced to interface, HID and interrupt IN
+// endpoint descriptors.
+
+#define cConfigurationHeaderSize  9
+#define cHidInterfaceDescriptorSize  (9 + 9 + 7) // Interface, HID, endpoint
+
+typedef uint8_t HidInterfaceDescriptor[cHidInterfaceDescriptorSize];
+
+
+// Number of HID interfaces (alternate setting 0) in a configuration descriptor.
+uint8_t countHidInterfaces(const uint8_t *configuration, uint16_t length);
+
+// Descriptors of the ordinal-th HID interface.  Return false if not found.
+// wDescriptorLength is limited to reportLengthMax, the bytes of a descriptor
+// report kept for PC.
+bool findHidInterface(const uint8_t *configuration, uint16_t length,
+                      uint8_t ordinal, uint16_t reportLengthMax,
+                      HidInterfaceDescriptor descriptor);
+
+// Interfaces are numbered in the order of the array and endpoint IN n + 1
+// is assigned to interface n.  Return the total length, 0 if size is short.
+uint16_t buildCompositeConfiguration(uint8_t *configuration, uint16_t size,
+                                     const uint8_t *header, uint8_t attributes, uint8_t maxPower,
+                                     const HidInterfaceDescriptor *interfaceArray,
+                                     const uint8_t *stringIndexArray, uint8_t interfaceNum);
+
+
+#endif /* #ifndef COMPOSITE_DESCRIPTOR_H */
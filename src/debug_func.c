@@ -3,12 +3,17 @@
 
 #include <pico/stdlib.h>
 #include <pico/mutex.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
 #include <hardware/uart.h>
 
 #include "debug_func.h"
 
 #define ENABLE_DEBUG_PRINTF  0
 
+// Binary log is cheap enough to be left enabled.
+#define ENABLE_DEBUG_LOG  1
+
 
 #define UART_ID  uart1
 #define BAUD_RATE  115200
@@ -25,14 +30,50 @@ static uart_inst_t *uart_inst;
 auto_init_mutex(s_uart_mutex);
 
 
+// Deferred binary log
+// One ring per core.  Writer is the owner core, reader is debugLogFlush()
+// on core0.  Write and read counts are free running.
+
+#define cDebugLogRecordNum  64 // Must be power of 2
+
+typedef struct {
+    uint16_t id;
+    uint8_t info; // bit 7: core, bit 0-2: number of arguments
+    uint8_t seq;
+    uint32_t time;
+    uint32_t argArray[cDebugLogArgMax];
+} DebugLogRecord;
+
+typedef struct {
+    DebugLogRecord recordArray[cDebugLogRecordNum];
+    volatile uint32_t writeCount;
+    volatile uint32_t readCount;
+    volatile uint32_t dropCount;
+    uint32_t reportedDropCount;
+    uint8_t seq;
+} DebugLogRing;
+
+static DebugLogRing sDebugLogRingArray[NUM_CORES];
+
+// Frame on UART: sync bytes + DebugLogRecord (little endian)
+static const uint8_t cDebugLogSync[2] = { 0xA5, 0x5A };
+#define cDebugLogFrameSize  (sizeof(cDebugLogSync) + sizeof(DebugLogRecord))
+
+static uint8_t sDebugLogFrame[cDebugLogFrameSize];
+static size_t sDebugLogFramePos = cDebugLogFrameSize;
+static size_t sDebugLogFlushCore = 0;
+
+
 int debugInit(void)
 {
-#if ENABLE_DEBUG_PRINTF
+#if ENABLE_DEBUG_PRINTF || ENABLE_DEBUG_LOG
     gpio_set_function(UART_TX_PIN, UART_FUNCSEL_NUM(UART_ID, UART_TX_PIN));
     gpio_set_function(UART_RX_PIN, UART_FUNCSEL_NUM(UART_ID, UART_RX_PIN));
 
     uart_init(UART_ID, BAUD_RATE);
+#endif
 
+#if ENABLE_DEBUG_PRINTF
     uart_inst = uart_get_instance(1);
     stdio_uart_init_full(uart_inst, BAUD_RATE, UART_TX_PIN, UART_RX_PIN);
 
@@ -75,3 +116,116 @@ int debugPrintf(const char *restrict format, ...)
     return 0;
 #endif
 }
+
+
+void debugLogWrite(uint32_t argNum, uint32_t id,
+                   uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+#if ENABLE_DEBUG_LOG
+    const uint32_t core = get_core_num();
+    DebugLogRing *ring = &sDebugLogRingArray[core];
+
+    uint32_t writeCount = ring->writeCount;
+    if (writeCount - ring->readCount >= cDebugLogRecordNum) {
+        ring->dropCount += 1;
+        return;
+    }
+
+    DebugLogRecord *record = &ring->recordArray[writeCount % cDebugLogRecordNum];
+    record->id = id;
+    record->info = (core << 7) | argNum;
+    record->seq = ring->seq++;
+    record->time = time_us_32();
+    record->argArray[0] = arg0;
+    record->argArray[1] = arg1;
+    record->argArray[2] = arg2;
+    record->argArray[3] = arg3;
+
+    // Publish the record after its contents.
+    __dmb();
+    ring->writeCount = writeCount + 1;
+#else
+    (void)argNum;
+    (void)id;
+    (void)arg0;
+    (void)arg1;
+    (void)arg2;
+    (void)arg3;
+#endif
+
+    return;
+}
+
+
+#if ENABLE_DEBUG_LOG
+static void setDebugLogFrame(const DebugLogRecord *record)
+{
+    (void)memcpy(sDebugLogFrame, cDebugLogSync, sizeof(cDebugLogSync));
+    (void)memcpy(&sDebugLogFrame[sizeof(cDebugLogSync)], record, sizeof(*record));
+    sDebugLogFramePos = 0;
+
+    return;
+}
+
+
+// Take a next record from rings.  Return false if all rings are empty.
+static bool loadDebugLogFrame(void)
+{
+    for (size_t n = 0; n < NUM_CORES; ++n) {
+        const size_t core = sDebugLogFlushCore;
+        DebugLogRing *ring = &sDebugLogRingArray[core];
+
+        sDebugLogFlushCore = (core + 1) % NUM_CORES;
+
+        uint32_t dropCount = ring->dropCount;
+        if (dropCount != ring->reportedDropCount) {
+            DebugLogRecord record = {
+                .id = LOG_DROPPED,
+                .info = 2,
+                .seq = 0,
+                .time = time_us_32(),
+                .argArray = { dropCount - ring->reportedDropCount, core, 0, 0 },
+            };
+            ring->reportedDropCount = dropCount;
+            setDebugLogFrame(&record);
+            return true;
+        }
+
+        uint32_t readCount = ring->readCount;
+        if (readCount != ring->writeCount) {
+            // Read the record after its write count.
+            __dmb();
+            setDebugLogFrame(&ring->recordArray[readCount % cDebugLogRecordNum]);
+            __dmb();
+            ring->readCount = readCount + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+#endif
+
+
+void debugLogFlush(void)
+{
+#if ENABLE_DEBUG_LOG
+    // Do not break a text line of debugPrintf().
+    if (mutex_try_enter(&s_uart_mutex, NULL) == false) {
+        return;
+    }
+
+    while (uart_is_writable(UART_ID)) {
+        if (sDebugLogFramePos == cDebugLogFrameSize) {
+            if (loadDebugLogFrame() == false) {
+                break;
+            }
+        }
+        uart_putc_raw(UART_ID, sDebugLogFrame[sDebugLogFramePos++]);
+    }
+
+    mutex_exit(&s_uart_mutex);
+#endif
+
+    return;
+}
@@ -1,10 +1,38 @@
 #ifndef DEBUG_FUNC_H
 #define DEBUG_FUNC_H
 
+#include <stdint.h>
+
+#include "debug_log_format.h"
+
 
 int debugInit(void);
 
 int debugPrintf(const char *restrict format, ...);
 
 
+// Deferred binary log
+// A call site only stores a format ID and up to 4 raw arguments to
+// a lock-free ring of the current core.  Formatting is done on PC by
+// tools/debug_log_decode.py.  Do not call from interrupt handlers.
+//   debugLog(LOG_DEVICE_REPORT_FAILED, instance, length);
+
+#define cDebugLogArgMax  4
+
+void debugLogWrite(uint32_t argNum, uint32_t id,
+                   uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+// Drain records to UART as long as UART FIFO is not full.  Never blocks.
+// Call from core0 idle loop.
+void debugLogFlush(void);
+
+#define DEBUG_LOG_ARG_NUM_(id, a0, a1, a2, a3, n, ...)  n
+#define DEBUG_LOG_ARGS_(id, a0, a1, a2, a3, ...) \
+    (uint32_t)(id), (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3)
+
+#define debugLog(...) \
+    debugLogWrite(DEBUG_LOG_ARG_NUM_(__VA_ARGS__, 4, 3, 2, 1, 0, 0), \
+                  DEBUG_LOG_ARGS_(__VA_ARGS__, 0, 0, 0, 0, 0))
+
+
 #endif /* #ifndef DEBUG_FUNC_H */
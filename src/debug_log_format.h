@@ -0,0 +1,41 @@
+#ifndef DEBUG_LOG_FORMAT_H
+#define DEBUG_LOG_FORMAT_H
+
+
+// Format table of the deferred binary log.
+// A record carries only the index of the entry and raw 32-bit arguments.
+// tools/debug_log_decode.py reads this file to reconstruct the text,
+// so keep one X() per line and append new entries at the end.
+
+#define DEBUG_LOG_FORMAT_LIST(X) \
+    X(LOG_DROPPED, "%u log records dropped on core %u") \
+    X(LOG_HOST_RECEIVE_REPORT_FAILED, "Failed to tuh_hid_receive_report(). addr = %02x, instance = %u") \
+    X(LOG_HOST_REPORT_RECEIVED, "report received cb: %02x %02x : instance = %u (%u)") \
+    X(LOG_DEVICE_HID_NOT_READY, "hid not ready, tud ready") \
+    X(LOG_DEVICE_REPORT_FAILED, "Failed to tud_hid_report(). instance = %u, length = %u") \
+    X(LOG_DEVICE_REPORT_SENT, "report sent: instance = %u, length = %u, %08x %08x") \
+    X(LOG_DESCRIPTOR_STRING_LANG, "not?: %02x  %04x") \
+    X(LOG_SUSPEND, "suspend: remote wakeup %u") \
+    X(LOG_RESUME, "resume: %u reports dropped") \
+    X(LOG_REMOTE_WAKEUP, "remote wakeup: instance = %u") \
+    X(LOG_UPSTREAM_RELEASING, "device removed or swapped: generation = %u") \
+    X(LOG_UPSTREAM_DISCONNECTED, "upstream disconnected: released in %u us") \
+    X(LOG_UPSTREAM_CONNECTED, "upstream connected: generation = %u") \
+    X(LOG_TELEMETRY, "telemetry %u = %u") \
+    X(LOG_HOST_REARMED, "host re-armed: instance = %u") \
+    X(LOG_HOST_PORT_RESET, "host port reset: re-arm failed for %u us") \
+    X(LOG_HOST_NOT_RECOVERED, "host not recovered: reboot by watchdog") \
+    X(LOG_WATCHDOG_REBOOT, "rebooted by watchdog") \
+    X(LOG_DEVICE_ATTACHED, "device attached: addr = %u, %u of %u HID interfaces proxied") \
+    X(LOG_DEVICE_DETACHED, "device detached: addr = %u") \
+
+
+enum {
+#define DEBUG_LOG_FORMAT_ENUM(id, format)  id,
+    DEBUG_LOG_FORMAT_LIST(DEBUG_LOG_FORMAT_ENUM)
+#undef DEBUG_LOG_FORMAT_ENUM
+    LOG_ID_NUM
+};
+
+
+#endif /* #ifndef DEBUG_LOG_FORMAT_H */
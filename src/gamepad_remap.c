@@ -0,0 +1,354 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "buf_func.h"
+#include "gamepad_remap.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+#define cUsageDesktopX  0x30
+#define cUsageDesktopWheel  0x38
+
+#define cCurveOne  0x7FFF // Q15
+
+
+// Configuration
+// Axes are identified by Generic Desktop usage.
+// To customize, change below.  Default is pass through.
+//   Swap X and Y:  X .source = 0x31, Y .source = 0x30
+//   Invert Y:      Y .isInverted = true
+//   Dead zone 10%: .deadZone = 100
+// -DGAMEPAD_REMAP_CONFIG='"file.h"' replaces both tables with the file.
+// Axes after the end of its axis table are passed as they are.
+typedef struct {
+    uint16_t source; // Usage of the input axis
+    bool isInverted;
+    uint16_t deadZone; // Per mille of half range
+    uint8_t curve; // GAMEPAD_CURVE_*
+} GamepadAxisConfig;
+
+#ifdef GAMEPAD_REMAP_CONFIG
+#include GAMEPAD_REMAP_CONFIG
+#else
+static const GamepadAxisConfig cGamepadAxisConfigArray[] = {
+    { 0x30, false, 0, GAMEPAD_CURVE_LINEAR }, // X
+    { 0x31, false, 0, GAMEPAD_CURVE_LINEAR }, // Y
+    { 0x32, false, 0, GAMEPAD_CURVE_LINEAR }, // Z
+    { 0x33, false, 0, GAMEPAD_CURVE_LINEAR }, // Rx
+    { 0x34, false, 0, GAMEPAD_CURVE_LINEAR }, // Ry
+    { 0x35, false, 0, GAMEPAD_CURVE_LINEAR }, // Rz
+    { 0x36, false, 0, GAMEPAD_CURVE_LINEAR }, // Slider
+    { 0x37, false, 0, GAMEPAD_CURVE_LINEAR }, // Dial
+    { 0x38, false, 0, GAMEPAD_CURVE_LINEAR }, // Wheel
+};
+
+// Output button i (0 origin) is taken from input button cGamepadButtonMap[i].
+static const uint8_t cGamepadButtonMap[cGamepadButtonMax] = {
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+};
+#endif
+
+
+typedef struct {
+    uint16_t bit;
+    uint8_t size; // <= 16
+    bool isSigned;
+    int32_t min;
+    int32_t max;
+    int32_t center;
+    uint16_t half; // Half range
+} GamepadAxisField;
+
+typedef struct {
+    bool isPassThrough;
+    uint8_t source; // Index of input axis
+    bool isInverted;
+    uint32_t scale; // |v| * scale = table position in Q16 (by the source half range)
+    uint16_t curveArray[cGamepadCurveSegmentNum + 1]; // Q15
+} GamepadAxisMap;
+
+typedef struct {
+    bool isUsed;
+    uint16_t byteLength;
+    uint8_t axisNum;
+    GamepadAxisField fieldArray[cHidAxisMax];
+    GamepadAxisMap mapArray[cHidAxisMax];
+    uint16_t buttonBit;
+    uint8_t buttonNum;
+    uint8_t buttonMap[cGamepadButtonMax];
+} GamepadBinding;
+
+static GamepadBinding sGamepadBindingArray[cGamepadBindingMax];
+
+
+static int32_t readAxis(const volatile uint8_t *report, const GamepadAxisField *field)
+{
+    uint32_t raw = readBits(report, field->bit, field->size);
+    int32_t v = (int32_t)raw;
+
+    if (field->isSigned == true && (raw & (1u << (field->size - 1))) != 0) {
+        v = (int32_t)(raw | ~((1u << field->size) - 1));
+    }
+
+    return v - field->center;
+}
+
+
+static void writeAxis(volatile uint8_t *report, const GamepadAxisField *field, int32_t v)
+{
+    v += field->center;
+    if (v < field->min) {
+        v = field->min;
+    } else if (v > field->max) {
+        v = field->max;
+    }
+    writeBits(report, field->bit, field->size, (uint32_t)v);
+
+    return;
+}
+
+
+// Centered input value of the source axis -> centered output value
+static int32_t mapAxis(const GamepadAxisMap *map, const GamepadAxisField *srcField,
+                       const GamepadAxisField *dstField, int32_t v)
+{
+    bool isNegative = (v < 0);
+    uint32_t a = isNegative ? (uint32_t)-v : (uint32_t)v;
+
+    if (a > srcField->half) {
+        a = srcField->half;
+    }
+
+    uint32_t pos = a * map->scale;
+    uint32_t index = pos >> 16;
+    uint32_t y;
+    if (index >= cGamepadCurveSegmentNum) {
+        y = map->curveArray[cGamepadCurveSegmentNum];
+    } else {
+        uint32_t y0 = map->curveArray[index];
+        uint32_t y1 = map->curveArray[index + 1];
+        y = y0 + (((y1 - y0) * (pos & 0xFFFF)) >> 16);
+    }
+
+    int32_t out = (int32_t)((y * dstField->half + (1u << 14)) >> 15);
+    if (isNegative != map->isInverted) {
+        out = -out;
+    }
+
+    return out;
+}
+
+
+static void kernelGamepad(volatile uint8_t *report, uint16_t length,
+                          const HidKernelParam *param)
+{
+    const GamepadBinding *binding = param->context;
+    int32_t inArray[cHidAxisMax];
+
+    if (binding->byteLength > length) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < binding->axisNum; ++i) {
+        inArray[i] = readAxis(report, &binding->fieldArray[i]);
+    }
+    for (uint8_t i = 0; i < binding->axisNum; ++i) {
+        const GamepadAxisMap *map = &binding->mapArray[i];
+        if (map->isPassThrough == true) {
+            continue;
+        }
+        int32_t v = mapAxis(map, &binding->fieldArray[map->source],
+                            &binding->fieldArray[i], inArray[map->source]);
+        writeAxis(report, &binding->fieldArray[i], v);
+    }
+
+    if (binding->buttonNum != 0) {
+        uint32_t in = readBits(report, binding->buttonBit, binding->buttonNum);
+        uint32_t out = 0;
+        for (uint8_t i = 0; i < binding->buttonNum; ++i) {
+            out |= ((in >> binding->buttonMap[i]) & 1u) << i;
+        }
+        writeBits(report, binding->buttonBit, binding->buttonNum, out);
+    }
+
+    return;
+}
+
+
+static const GamepadAxisConfig *findAxisConfig(uint16_t usage)
+{
+    if (usage < cUsageDesktopX || usage > cUsageDesktopWheel ||
+        (size_t)(usage - cUsageDesktopX) >= ARRAY_NUM(cGamepadAxisConfigArray)) {
+        return NULL;
+    }
+
+    return &cGamepadAxisConfigArray[usage - cUsageDesktopX];
+}
+
+
+// Response curve of x (Q15) -> Q15
+static uint32_t curve(uint8_t type, uint32_t x)
+{
+    switch (type) {
+    case GAMEPAD_CURVE_QUADRATIC:
+        return (x * x) >> 15;
+    case GAMEPAD_CURVE_CUBIC:
+        return (((x * x) >> 15) * x) >> 15;
+    default:
+        return x;
+    }
+}
+
+
+static void makeCurve(GamepadAxisMap *map, const GamepadAxisConfig *config)
+{
+    uint32_t deadZone = config->deadZone;
+    if (deadZone >= 1000) {
+        deadZone = 999;
+    }
+    const uint32_t dz = deadZone * cCurveOne / 1000;
+
+    for (uint32_t i = 0; i <= cGamepadCurveSegmentNum; ++i) {
+        uint32_t x = i * cCurveOne / cGamepadCurveSegmentNum;
+        if (x <= dz) {
+            map->curveArray[i] = 0;
+        } else {
+            uint32_t t = (x - dz) * cCurveOne / (cCurveOne - dz);
+            map->curveArray[i] = curve(config->curve, t);
+        }
+    }
+
+    return;
+}
+
+
+static bool setAxisField(GamepadAxisField *field, const HidField *hidField)
+{
+    // Range wider than the field is a broken descriptor.
+    if (hidField->size == 0 || hidField->size > 16 || hidField->logicalMax <= hidField->logicalMin ||
+        hidField->logicalMax - hidField->logicalMin > 0xFFFF) {
+        return false;
+    }
+
+    field->bit = hidField->bit;
+    field->size = hidField->size;
+    field->isSigned = (hidField->logicalMin < 0);
+    field->min = hidField->logicalMin;
+    field->max = hidField->logicalMax;
+    field->center = (hidField->logicalMin + hidField->logicalMax + 1) / 2;
+    field->half = (uint16_t)((hidField->logicalMax - hidField->logicalMin) / 2);
+    if (field->half == 0) {
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool isAxisIdentity(const GamepadAxisConfig *config, uint16_t usage)
+{
+    return (config->source == usage && config->isInverted == false &&
+            config->deadZone == 0 && config->curve == GAMEPAD_CURVE_LINEAR);
+}
+
+
+static bool isIdentity(const GamepadBinding *binding)
+{
+    for (uint8_t i = 0; i < binding->axisNum; ++i) {
+        if (binding->mapArray[i].isPassThrough == false) {
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < binding->buttonNum; ++i) {
+        if (binding->buttonMap[i] != i) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool bindGamepadKernel(HidKernel *kernel, const HidReportLayout *layout)
+{
+    GamepadBinding *binding = NULL;
+    uint16_t usageArray[cHidAxisMax];
+
+    for (size_t i = 0; i < ARRAY_NUM(sGamepadBindingArray); ++i) {
+        if (sGamepadBindingArray[i].isUsed == false) {
+            binding = &sGamepadBindingArray[i];
+            break;
+        }
+    }
+    if (binding == NULL) {
+        return false;
+    }
+    (void)memset(binding, 0, sizeof(*binding));
+
+    for (uint8_t i = 0; i < layout->axisNum; ++i) {
+        const HidField *hidField = &layout->axisArray[i];
+        if (findAxisConfig(hidField->usage) == NULL) {
+            continue;
+        }
+        if (setAxisField(&binding->fieldArray[binding->axisNum], hidField) == false) {
+            continue;
+        }
+        usageArray[binding->axisNum] = hidField->usage;
+        binding->axisNum += 1;
+    }
+
+    for (uint8_t i = 0; i < binding->axisNum; ++i) {
+        const GamepadAxisConfig *config = findAxisConfig(usageArray[i]);
+        GamepadAxisMap *map = &binding->mapArray[i];
+
+        // Linear table is not exact.  Keep the value as is.
+        map->isPassThrough = isAxisIdentity(config, usageArray[i]);
+        map->source = i;
+        for (uint8_t j = 0; j < binding->axisNum; ++j) {
+            if (usageArray[j] == config->source) {
+                map->source = j;
+                break;
+            }
+        }
+        map->isInverted = config->isInverted;
+        map->scale = ((uint32_t)cGamepadCurveSegmentNum << 16) / binding->fieldArray[map->source].half;
+        makeCurve(map, config);
+    }
+
+    if (layout->button.size == 1 && layout->buttonNum != 0) {
+        binding->buttonBit = layout->button.bit;
+        binding->buttonNum = (layout->buttonNum > cGamepadButtonMax) ? cGamepadButtonMax : layout->buttonNum;
+        for (uint8_t i = 0; i < binding->buttonNum; ++i) {
+            uint8_t source = cGamepadButtonMap[i];
+            binding->buttonMap[i] = (source < binding->buttonNum) ? source : i;
+        }
+    }
+
+    binding->byteLength = (layout->bitLength + 7) / 8;
+
+    if (isIdentity(binding) == true) {
+        return false;
+    }
+
+    binding->isUsed = true;
+    kernel->func = kernelGamepad;
+    kernel->param.context = binding;
+
+    return true;
+}
+
+
+void releaseGamepadKernel(HidKernel *kernel)
+{
+    if (kernel->func != kernelGamepad) {
+        return;
+    }
+
+    GamepadBinding *binding = (GamepadBinding *)kernel->param.context;
+    binding->isUsed = false;
+    kernel->param.context = NULL;
+
+    return;
+}
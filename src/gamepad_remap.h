@@ -0,0 +1,35 @@
+#ifndef GAMEPAD_REMAP_H
+#define GAMEPAD_REMAP_H
+
+#include <stdbool.h>
+
+#include "hid_report_map.h"
+#include "hid_transform.h"
+
+
+// Gamepad/joystick kernel
+// Button remap, axis swap/inversion, dead zone and response curve.
+// Configuration is in gamepad_remap.c.  Integer only, and the cost per
+// report is bounded by cHidAxisMax axes and cGamepadButtonMax buttons.
+
+#define cGamepadBindingMax  2
+#define cGamepadButtonMax  32
+
+// Points of the dead zone + response curve table per axis
+#define cGamepadCurveSegmentNum  16
+
+enum {
+    GAMEPAD_CURVE_LINEAR,
+    GAMEPAD_CURVE_QUADRATIC,
+    GAMEPAD_CURVE_CUBIC,
+};
+
+
+// Return false if nothing to remap in the layout or no free binding.
+bool bindGamepadKernel(HidKernel *kernel, const HidReportLayout *layout);
+
+// Do nothing if the kernel is not a gamepad kernel.
+void releaseGamepadKernel(HidKernel *kernel);
+
+
+#endif /* #ifndef GAMEPAD_REMAP_H */
@@ -0,0 +1,381 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "hid_report_map.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+
+// Item types and tags (HID 1.11, 6.2.2)
+enum {
+    ITEM_TYPE_MAIN = 0,
+    ITEM_TYPE_GLOBAL = 1,
+    ITEM_TYPE_LOCAL = 2,
+};
+
+enum {
+    MAIN_INPUT = 0x8,
+    MAIN_OUTPUT = 0x9,
+    MAIN_COLLECTION = 0xA,
+    MAIN_FEATURE = 0xB,
+    MAIN_END_COLLECTION = 0xC,
+};
+
+enum {
+    GLOBAL_USAGE_PAGE = 0x0,
+    GLOBAL_LOGICAL_MIN = 0x1,
+    GLOBAL_LOGICAL_MAX = 0x2,
+    GLOBAL_REPORT_SIZE = 0x7,
+    GLOBAL_REPORT_ID = 0x8,
+    GLOBAL_REPORT_COUNT = 0x9,
+    GLOBAL_PUSH = 0xA,
+    GLOBAL_POP = 0xB,
+};
+
+enum {
+    LOCAL_USAGE = 0x0,
+    LOCAL_USAGE_MIN = 0x1,
+    LOCAL_USAGE_MAX = 0x2,
+};
+
+#define cItemLong  0xFE
+
+#define cCollectionApplication  0x01
+
+#define cInputConstant  0x01
+#define cInputVariable  0x02
+#define cInputRelative  0x04
+
+#define cUsagePageDesktop  0x01
+#define cUsagePageKeyboard  0x07
+#define cUsagePageButton  0x09
+#define cUsagePageConsumer  0x0C
+
+#define cUsageDesktopMouse  0x02
+#define cUsageDesktopJoystick  0x04
+#define cUsageDesktopGamepad  0x05
+#define cUsageDesktopKeyboard  0x06
+#define cUsageDesktopX  0x30
+#define cUsageDesktopWheel  0x38
+#define cUsageDesktopHat  0x39
+#define cUsageConsumerControl  0x01
+#define cUsageConsumerPan  0x238
+
+#define cUsageKeyboardLeftControl  0xE0
+
+#define cUsageListMax  16
+#define cGlobalStackMax  4
+
+
+typedef struct {
+    uint16_t usagePage;
+    int32_t logicalMin;
+    int32_t logicalMax;
+    uint32_t reportSize;
+    uint32_t reportCount;
+    uint8_t reportId;
+} GlobalState;
+
+typedef struct {
+    uint16_t usageArray[cUsageListMax];
+    uint8_t usageNum;
+    uint16_t usageMin;
+    uint16_t usageMax;
+    bool hasUsageMin;
+} LocalState;
+
+
+static uint32_t itemData(const volatile uint8_t *data, uint8_t size)
+{
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < size; ++i) {
+        v |= (uint32_t)data[i] << (8 * i);
+    }
+
+    return v;
+}
+
+
+static int32_t itemSignedData(const volatile uint8_t *data, uint8_t size)
+{
+    uint32_t v = itemData(data, size);
+    if (size == 1) {
+        return (int8_t)v;
+    } else if (size == 2) {
+        return (int16_t)v;
+    }
+
+    return (int32_t)v;
+}
+
+
+static uint8_t classifyApplication(uint16_t usagePage, uint16_t usage)
+{
+    if (usagePage == cUsagePageDesktop) {
+        switch (usage) {
+        case cUsageDesktopMouse:
+            return HID_APP_MOUSE;
+        case cUsageDesktopKeyboard:
+            return HID_APP_KEYBOARD;
+        case cUsageDesktopJoystick:
+            return HID_APP_JOYSTICK;
+        case cUsageDesktopGamepad:
+            return HID_APP_GAMEPAD;
+        default:
+            break;
+        }
+    } else if (usagePage == cUsagePageConsumer && usage == cUsageConsumerControl) {
+        return HID_APP_CONSUMER;
+    }
+
+    return HID_APP_OTHER;
+}
+
+
+static HidReportLayout *getLayout(HidReportMap *map, uint8_t reportId)
+{
+    for (size_t i = 0; i < map->layoutNum; ++i) {
+        if (map->layoutArray[i].reportId == reportId) {
+            return &map->layoutArray[i];
+        }
+    }
+    if (map->layoutNum >= ARRAY_NUM(map->layoutArray)) {
+        return NULL;
+    }
+
+    HidReportLayout *layout = &map->layoutArray[map->layoutNum++];
+    (void)memset(layout, 0, sizeof(*layout));
+    layout->reportId = reportId;
+    layout->application = HID_APP_OTHER;
+    layout->bitLength = (reportId != 0) ? 8 : 0;
+
+    return layout;
+}
+
+
+static uint16_t localUsage(const LocalState *local, uint32_t index)
+{
+    if (local->usageNum != 0) {
+        if (index >= local->usageNum) {
+            index = local->usageNum - 1;
+        }
+        return local->usageArray[index];
+    }
+    if (local->hasUsageMin) {
+        uint32_t usage = local->usageMin + index;
+        return (usage > local->usageMax) ? local->usageMax : (uint16_t)usage;
+    }
+
+    return 0;
+}
+
+
+static void setField(HidField *field, uint32_t bit, uint16_t usage,
+                     const GlobalState *global, uint32_t flags)
+{
+    field->bit = (uint16_t)bit;
+    field->usage = usage;
+    field->logicalMin = global->logicalMin;
+    field->logicalMax = global->logicalMax;
+    field->size = (uint8_t)global->reportSize;
+    field->isRelative = ((flags & cInputRelative) != 0);
+
+    return;
+}
+
+
+static void addInput(HidReportLayout *layout, uint32_t flags,
+                     const GlobalState *global, const LocalState *local)
+{
+    const uint32_t bit = layout->bitLength;
+    const uint32_t size = global->reportSize;
+    const uint32_t count = global->reportCount;
+
+    if (size != 0 && count != 0 && (flags & (cInputConstant | cInputRelative)) == cInputRelative) {
+        layout->hasRelative = true;
+    }
+
+    if (size == 0 || size > 32 || (flags & cInputConstant) != 0) {
+        // Padding
+    } else if ((flags & cInputVariable) == 0) {
+        // Array
+        if (global->usagePage == cUsagePageKeyboard && layout->keyArray.size == 0) {
+            setField(&layout->keyArray, bit, localUsage(local, 0), global, flags);
+            layout->keyArrayNum = (uint8_t)count;
+        }
+    } else if (global->usagePage == cUsagePageKeyboard) {
+        uint16_t first = localUsage(local, 0);
+        if (first == cUsageKeyboardLeftControl && size == 1 && count >= 8) {
+            if (layout->modifier.size == 0) {
+                setField(&layout->modifier, bit, first, global, flags);
+                layout->modifier.size = 8;
+            }
+        } else if (size == 1 && layout->keyBitmap.size == 0) {
+            setField(&layout->keyBitmap, bit, first, global, flags);
+            layout->keyBitmapNum = (uint16_t)count;
+        }
+    } else if (global->usagePage == cUsagePageButton) {
+        if (layout->button.size == 0) {
+            setField(&layout->button, bit, localUsage(local, 0), global, flags);
+            layout->buttonNum = (uint8_t)count;
+        }
+    } else if (global->usagePage == cUsagePageDesktop ||
+               global->usagePage == cUsagePageConsumer) {
+        for (uint32_t i = 0; i < count; ++i) {
+            uint16_t usage = localUsage(local, i);
+            uint32_t fieldBit = bit + size * i;
+            if (global->usagePage == cUsagePageDesktop && usage == cUsageDesktopHat) {
+                if (layout->hat.size == 0) {
+                    setField(&layout->hat, fieldBit, usage, global, flags);
+                }
+            } else if ((global->usagePage == cUsagePageDesktop &&
+                        usage >= cUsageDesktopX && usage <= cUsageDesktopWheel) ||
+                       (global->usagePage == cUsagePageConsumer && usage == cUsageConsumerPan)) {
+                if (layout->axisNum < ARRAY_NUM(layout->axisArray)) {
+                    setField(&layout->axisArray[layout->axisNum++], fieldBit, usage, global, flags);
+                }
+            }
+        }
+    }
+
+    {
+        uint32_t bitLength = bit + size * count;
+        layout->bitLength = (bitLength > UINT16_MAX) ? UINT16_MAX : (uint16_t)bitLength;
+    }
+
+    return;
+}
+
+
+bool parseHidReportMap(HidReportMap *map, const volatile uint8_t *descriptor, uint16_t length)
+{
+    GlobalState global;
+    GlobalState globalStack[cGlobalStackMax]; // Push and Pop
+    uint32_t globalStackNum = 0;
+    LocalState local;
+    uint8_t application = HID_APP_OTHER;
+    uint32_t depth = 0;
+
+    (void)memset(map, 0, sizeof(*map));
+    (void)memset(&global, 0, sizeof(global));
+    (void)memset(&local, 0, sizeof(local));
+
+    for (uint32_t pos = 0; pos < length; ) {
+        const uint8_t prefix = descriptor[pos];
+
+        if (prefix == cItemLong) {
+            if (pos + 2 >= length) {
+                return false;
+            }
+            pos += 3 + descriptor[pos + 1];
+            continue;
+        }
+
+        const uint8_t size = ((prefix & 0x3) == 3) ? 4 : (prefix & 0x3);
+        const uint8_t type = (prefix >> 2) & 0x3;
+        const uint8_t tag = prefix >> 4;
+
+        if (pos + 1 + size > length) {
+            return false;
+        }
+        const volatile uint8_t *data = &descriptor[pos + 1];
+        const uint32_t value = itemData(data, size);
+        pos += 1 + size;
+
+        if (type == ITEM_TYPE_MAIN) {
+            if (tag == MAIN_INPUT) {
+                HidReportLayout *layout = getLayout(map, global.reportId);
+                if (layout != NULL) {
+                    if (layout->application == HID_APP_OTHER) {
+                        layout->application = application;
+                    }
+                    addInput(layout, value, &global, &local);
+                }
+            } else if (tag == MAIN_COLLECTION) {
+                if (depth == 0 && value == cCollectionApplication) {
+                    application = classifyApplication(global.usagePage, localUsage(&local, 0));
+                }
+                depth += 1;
+            } else if (tag == MAIN_END_COLLECTION) {
+                if (depth > 0) {
+                    depth -= 1;
+                }
+            }
+            (void)memset(&local, 0, sizeof(local));
+        } else if (type == ITEM_TYPE_GLOBAL) {
+            switch (tag) {
+            case GLOBAL_USAGE_PAGE:
+                global.usagePage = (uint16_t)value;
+                break;
+            case GLOBAL_LOGICAL_MIN:
+                global.logicalMin = itemSignedData(data, size);
+                break;
+            case GLOBAL_LOGICAL_MAX:
+                global.logicalMax = itemSignedData(data, size);
+                // Unsigned if minimum is not negative.
+                if (global.logicalMin >= 0 && global.logicalMax < 0) {
+                    global.logicalMax = (int32_t)value;
+                }
+                break;
+            case GLOBAL_REPORT_SIZE:
+                global.reportSize = value;
+                break;
+            case GLOBAL_REPORT_ID:
+                global.reportId = (uint8_t)value;
+                map->hasReportId = true;
+                break;
+            case GLOBAL_REPORT_COUNT:
+                global.reportCount = value;
+                break;
+            case GLOBAL_PUSH:
+                if (globalStackNum >= ARRAY_NUM(globalStack)) {
+                    return false;
+                }
+                globalStack[globalStackNum++] = global;
+                break;
+            case GLOBAL_POP:
+                if (globalStackNum == 0) {
+                    return false;
+                }
+                global = globalStack[--globalStackNum];
+                break;
+            default:
+                break;
+            }
+        } else if (type == ITEM_TYPE_LOCAL) {
+            // Extended usage (4 bytes) has its usage page in the upper 16 bits.
+            // Usage page is assumed to be the same as the global one.
+            switch (tag) {
+            case LOCAL_USAGE:
+                if (local.usageNum < ARRAY_NUM(local.usageArray)) {
+                    local.usageArray[local.usageNum++] = (uint16_t)value;
+                }
+                break;
+            case LOCAL_USAGE_MIN:
+                local.usageMin = (uint16_t)value;
+                local.hasUsageMin = true;
+                break;
+            case LOCAL_USAGE_MAX:
+                local.usageMax = (uint16_t)value;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+const HidReportLayout *findHidReportLayout(const HidReportMap *map, uint8_t reportId)
+{
+    for (size_t i = 0; i < map->layoutNum; ++i) {
+        if (map->layoutArray[i].reportId == reportId) {
+            return &map->layoutArray[i];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,66 @@
+#ifndef HID_REPORT_MAP_H
+#define HID_REPORT_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Field map of input reports built from a descriptor report.
+// Only fields needed to transform reports are picked up.
+
+#define cHidReportLayoutMax  8
+#define cHidAxisMax  8
+
+enum {
+    HID_APP_OTHER,
+    HID_APP_MOUSE,
+    HID_APP_KEYBOARD,
+    HID_APP_CONSUMER,
+    HID_APP_JOYSTICK,
+    HID_APP_GAMEPAD,
+};
+
+typedef struct {
+    uint16_t bit; // Offset from the beginning of the report (Report ID included)
+    uint16_t usage;
+    int32_t logicalMin;
+    int32_t logicalMax;
+    uint8_t size; // Bits of one field.  0 means not present.
+    bool isRelative; // Input Relative (delta), not a state
+} HidField;
+
+typedef struct {
+    uint8_t reportId; // 0: no Report ID
+    uint8_t application;
+    uint16_t bitLength; // Report ID included
+    bool hasRelative; // Any Input Relative field, picked up or not
+
+    HidField modifier; // LeftControl to RightGUI.  size is 8.
+    HidField keyArray; // Array of keycodes
+    uint8_t keyArrayNum;
+    HidField keyBitmap; // NKRO. usage is the first keycode of size 1 fields.
+    uint16_t keyBitmapNum;
+
+    HidField button; // usage is the first button.  size is 1.
+    uint8_t buttonNum;
+    HidField axisArray[cHidAxisMax]; // X, Y, Z, Rx, Ry, Rz, Slider, Dial, Wheel
+    uint8_t axisNum;
+    HidField hat;
+} HidReportLayout;
+
+typedef struct {
+    bool hasReportId;
+    uint8_t layoutNum;
+    HidReportLayout layoutArray[cHidReportLayoutMax];
+} HidReportMap;
+
+
+// Return false if the descriptor report is broken.
+// Fields after cHidReportLayoutMax report IDs are ignored.
+bool parseHidReportMap(HidReportMap *map, const volatile uint8_t *descriptor, uint16_t length);
+
+// Return NULL if not found.
+const HidReportLayout *findHidReportLayout(const HidReportMap *map, uint8_t reportId);
+
+
+#endif /* #ifndef HID_REPORT_MAP_H */
@@ -0,0 +1,331 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "gamepad_remap.h"
+#include "hid_transform.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+#define cKeyCaps  0x39
+#define cModifierLeftControl  0x01
+
+#define cBootKeyNum  6
+
+
+// Swap left control and caps.
+// keys is an array of keycodes (boot keyboard: report[2] to report[7]).
+static inline void swapCapsControl(volatile uint8_t *modifier,
+                                   volatile uint8_t *keys, uint16_t keyNum)
+{
+    uint8_t firstByte = *modifier;
+    bool isControlPushed = (firstByte & cModifierLeftControl);
+    uint16_t capsIndex = keyNum;
+
+    for (uint16_t i = 0; i < keyNum; ++i) {
+        uint8_t c = keys[i];
+        if (c == cKeyCaps) {
+            capsIndex = i;
+            break;
+        }
+    }
+
+    // The keycodes are listed by the pushed order.
+    // (First pushed key is located in the first byte,
+    // second pushed key is in the second byte)
+    // In some case, the order is not maintained in some case, but
+    // it must work in most cases...
+    if (capsIndex != keyNum) {
+        firstByte |= cModifierLeftControl;
+
+        if (isControlPushed == false) {
+            for (uint16_t i = capsIndex; i < keyNum - 1; ++i) {
+                keys[i] = keys[i + 1];
+            }
+            keys[keyNum - 1] = 0x00;
+        }
+    } else if (isControlPushed == true) {
+        firstByte &= ~cModifierLeftControl;
+        // To emulate FIFO, it must check new and old buffer.
+        // It loads much, but in most cases no need to do so.
+        // Put caps at the end of buffer.
+        uint16_t i = 0;
+        for ( ; i < keyNum; ++i) {
+            if (keys[i] == 0x00) {
+                keys[i] = cKeyCaps;
+                break;
+            }
+        }
+        if (i == keyNum && keyNum != 0) {
+            for (i = 0; i < keyNum - 1; ++i) {
+                keys[i] = keys[i + 1];
+            }
+            keys[keyNum - 1] = cKeyCaps;
+        }
+    }
+
+    *modifier = firstByte;
+
+    return;
+}
+
+
+// Swap left and right buttons.
+static inline void swapLeftRight(volatile uint8_t *buttonByte)
+{
+    uint8_t buttons = *buttonByte;
+    buttons = (buttons & ~0x03) | ((buttons >> 1) & 0x1) | ((buttons & 0x1) << 1);
+    *buttonByte = buttons;
+
+    return;
+}
+
+
+// Kernels
+
+static void kernelPassThrough(volatile uint8_t *report, uint16_t length,
+                              const HidKernelParam *param)
+{
+    (void)report;
+    (void)length;
+    (void)param;
+
+    return;
+}
+
+
+// Boot keyboard: [Report ID], modifier, reserved, 6 keycodes
+#define DEFINE_KEYBOARD_BOOT_KERNEL(name, idOffset) \
+    static void name(volatile uint8_t *report, uint16_t length, \
+                     const HidKernelParam *param) \
+    { \
+        (void)param; \
+        if (length < (idOffset) + 2 + cBootKeyNum) { \
+            return; \
+        } \
+        swapCapsControl(&report[(idOffset)], &report[(idOffset) + 2], cBootKeyNum); \
+    }
+
+DEFINE_KEYBOARD_BOOT_KERNEL(kernelKeyboardBoot, 0)
+DEFINE_KEYBOARD_BOOT_KERNEL(kernelKeyboardBootId, 1)
+
+
+// Keycode array at other position
+// offset0: modifier, offset1: keycode array, num: keycodes
+static void kernelKeyboardArray(volatile uint8_t *report, uint16_t length,
+                                const HidKernelParam *param)
+{
+    if (param->offset1 + param->num > length) {
+        return;
+    }
+    swapCapsControl(&report[param->offset0], &report[param->offset1], param->num);
+
+    return;
+}
+
+
+// NKRO bitmap
+// offset0: modifier, offset1: byte of caps bit, mask: caps bit
+// Bitmap has no order, so simply exchange two bits.
+static void kernelKeyboardBitmap(volatile uint8_t *report, uint16_t length,
+                                 const HidKernelParam *param)
+{
+    if (param->offset1 >= length) {
+        return;
+    }
+
+    uint8_t modifier = report[param->offset0];
+    uint8_t caps = report[param->offset1];
+    uint8_t isControl = (modifier & cModifierLeftControl) ? 0xFF : 0x00;
+    uint8_t isCaps = (caps & param->mask) ? 0xFF : 0x00;
+
+    report[param->offset0] = (modifier & ~cModifierLeftControl) | (isCaps & cModifierLeftControl);
+    report[param->offset1] = (caps & ~param->mask) | (isControl & param->mask);
+
+    return;
+}
+
+
+// Mouse: [Report ID], buttons, axes (any size)
+// Only the button byte is touched, so axis size does not make a difference.
+#define DEFINE_MOUSE_KERNEL(name, idOffset) \
+    static void name(volatile uint8_t *report, uint16_t length, \
+                     const HidKernelParam *param) \
+    { \
+        (void)param; \
+        if (length <= (idOffset)) { \
+            return; \
+        } \
+        swapLeftRight(&report[(idOffset)]); \
+    }
+
+DEFINE_MOUSE_KERNEL(kernelMouse, 0)
+DEFINE_MOUSE_KERNEL(kernelMouseId, 1)
+
+
+// offset0: button byte
+static void kernelMouseAt(volatile uint8_t *report, uint16_t length,
+                          const HidKernelParam *param)
+{
+    if (param->offset0 >= length) {
+        return;
+    }
+    swapLeftRight(&report[param->offset0]);
+
+    return;
+}
+
+
+static bool byteOffset(const HidField *field, uint8_t *offset)
+{
+    if ((field->bit % 8) != 0 || field->bit / 8 > UINT8_MAX) {
+        return false;
+    }
+    *offset = field->bit / 8;
+
+    return true;
+}
+
+
+static void selectKeyboardKernel(HidKernel *kernel, const HidReportLayout *layout)
+{
+    uint8_t modifierOffset;
+
+    if (layout->modifier.size != 8 || byteOffset(&layout->modifier, &modifierOffset) == false) {
+        return;
+    }
+
+    if (layout->keyArray.size == 8 && layout->keyArrayNum != 0) {
+        uint8_t keyOffset;
+        if (byteOffset(&layout->keyArray, &keyOffset) == false) {
+            return;
+        }
+        if (modifierOffset <= 1 && keyOffset == modifierOffset + 2 &&
+            layout->keyArrayNum == cBootKeyNum) {
+            kernel->func = (modifierOffset == 0) ? kernelKeyboardBoot : kernelKeyboardBootId;
+        } else {
+            kernel->func = kernelKeyboardArray;
+            kernel->param.offset0 = modifierOffset;
+            kernel->param.offset1 = keyOffset;
+            kernel->param.num = layout->keyArrayNum;
+        }
+    } else if (layout->keyBitmap.size == 1 &&
+               layout->keyBitmap.usage <= cKeyCaps &&
+               cKeyCaps < layout->keyBitmap.usage + layout->keyBitmapNum) {
+        uint32_t capsBit = layout->keyBitmap.bit + (cKeyCaps - layout->keyBitmap.usage);
+        if (capsBit / 8 > UINT8_MAX) {
+            return;
+        }
+        kernel->func = kernelKeyboardBitmap;
+        kernel->param.offset0 = modifierOffset;
+        kernel->param.offset1 = capsBit / 8;
+        kernel->param.mask = 1 << (capsBit % 8);
+    }
+
+    return;
+}
+
+
+static void selectMouseKernel(HidKernel *kernel, const HidReportLayout *layout)
+{
+    uint8_t buttonOffset;
+
+    // Left and right must be button 1 and 2 in the same byte.
+    if (layout->buttonNum < 2 || layout->button.usage > 1 ||
+        byteOffset(&layout->button, &buttonOffset) == false) {
+        return;
+    }
+
+    if (buttonOffset == 0) {
+        kernel->func = kernelMouse;
+    } else if (buttonOffset == 1) {
+        kernel->func = kernelMouseId;
+    } else {
+        kernel->func = kernelMouseAt;
+        kernel->param.offset0 = buttonOffset;
+    }
+
+    return;
+}
+
+
+static void selectKernel(HidKernel *kernel, const HidReportLayout *layout)
+{
+    kernel->func = kernelPassThrough;
+    (void)memset(&kernel->param, 0, sizeof(kernel->param));
+
+    switch (layout->application) {
+    case HID_APP_KEYBOARD:
+        selectKeyboardKernel(kernel, layout);
+        break;
+    case HID_APP_MOUSE:
+        selectMouseKernel(kernel, layout);
+        break;
+    case HID_APP_JOYSTICK:
+    case HID_APP_GAMEPAD:
+        (void)bindGamepadKernel(kernel, layout);
+        break;
+    default:
+        break;
+    }
+
+    return;
+}
+
+
+void clearHidKernelTable(HidKernelTable *table)
+{
+    table->reportIdMask = 0x00;
+    table->releaseMask = 0x0000;
+    table->dedupMask = 0x0000;
+    for (size_t i = 0; i < ARRAY_NUM(table->kernelArray); ++i) {
+        releaseGamepadKernel(&table->kernelArray[i]);
+        table->kernelArray[i].func = kernelPassThrough;
+        (void)memset(&table->kernelArray[i].param, 0, sizeof(table->kernelArray[i].param));
+    }
+
+    return;
+}
+
+
+void moveHidKernelTable(HidKernelTable *dst, HidKernelTable *src)
+{
+    clearHidKernelTable(dst);
+    *dst = *src;
+
+    // Bound contexts belong to dst now.  Do not release them.
+    for (size_t i = 0; i < ARRAY_NUM(src->kernelArray); ++i) {
+        src->kernelArray[i].func = kernelPassThrough;
+    }
+    clearHidKernelTable(src);
+
+    return;
+}
+
+
+void bindHidKernelTable(HidKernelTable *table, const HidReportMap *map)
+{
+    clearHidKernelTable(table);
+
+    table->reportIdMask = (map->hasReportId == true) ? 0xFF : 0x00;
+
+    for (size_t i = 0; i < map->layoutNum; ++i) {
+        const HidReportLayout *layout = &map->layoutArray[i];
+        if (layout->reportId < ARRAY_NUM(table->kernelArray)) {
+            selectKernel(&table->kernelArray[layout->reportId], layout);
+            if (layout->application == HID_APP_KEYBOARD ||
+                layout->application == HID_APP_MOUSE ||
+                layout->application == HID_APP_CONSUMER) {
+                table->releaseMask |= 1 << layout->reportId;
+            }
+            // A relative field makes two same reports two steps.
+            if (layout->application != HID_APP_MOUSE &&
+                layout->application != HID_APP_OTHER &&
+                layout->hasRelative == false) {
+                table->dedupMask |= 1 << layout->reportId;
+            }
+        }
+    }
+
+    return;
+}
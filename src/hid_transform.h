@@ -0,0 +1,78 @@
+#ifndef HID_TRANSFORM_H
+#define HID_TRANSFORM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hid_report_map.h"
+
+
+// Transform kernels modify a report in the ring buffer in place.
+// A kernel is specialized for a device type and field layout, and bound to
+// (instance, report ID) at mount.  Per report path only looks up the table.
+
+// Report IDs over this use entry 0 (pass through).
+#define cHidKernelReportIdNum  16
+
+typedef struct {
+    uint8_t offset0; // Byte offsets of fields (Report ID included)
+    uint8_t offset1;
+    uint8_t num;
+    uint8_t mask;
+    const void *context; // Kernel specific data bigger than above
+} HidKernelParam;
+
+typedef void (*HidKernelFunc)(volatile uint8_t *report, uint16_t length,
+                              const HidKernelParam *param);
+
+typedef struct {
+    HidKernelFunc func;
+    HidKernelParam param;
+} HidKernel;
+
+typedef struct {
+    uint8_t reportIdMask; // 0x00 if the instance has no Report ID
+    uint16_t releaseMask; // Report IDs of keys and buttons (keyboard, mouse, consumer)
+    uint16_t dedupMask; // Report IDs of states (keyboard, consumer, joystick, gamepad) without relative fields
+    HidKernel kernelArray[cHidKernelReportIdNum];
+} HidKernelTable;
+
+
+// Bind kernels to all layouts in the map.
+void bindHidKernelTable(HidKernelTable *table, const HidReportMap *map);
+
+// Unbound table passes through all reports.
+void clearHidKernelTable(HidKernelTable *table);
+
+// Move bindings to another table.  src is left unbound.
+void moveHidKernelTable(HidKernelTable *dst, HidKernelTable *src);
+
+// Index of the report in the table
+static inline uint8_t hidKernelIndex(const HidKernelTable *table,
+                                     const volatile uint8_t *report)
+{
+    uint8_t index = report[0] & table->reportIdMask;
+    if (index >= cHidKernelReportIdNum) {
+        index = 0;
+    }
+
+    return index;
+}
+
+static inline const HidKernel *findHidKernel(const HidKernelTable *table,
+                                             const volatile uint8_t *report)
+{
+    return &table->kernelArray[hidKernelIndex(table, report)];
+}
+
+static inline void runHidKernel(const HidKernelTable *table,
+                                volatile uint8_t *report, uint16_t length)
+{
+    const HidKernel *kernel = findHidKernel(table, report);
+    kernel->func(report, length, &kernel->param);
+
+    return;
+}
+
+
+#endif /* #ifndef HID_TRANSFORM_H */
@@ -0,0 +1,319 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "key_debounce.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+#define cKeyErrorRollOver  0x01
+#define cKeyLeftControl  0xE0
+
+static const uint32_t cWindowUs = KEY_DEBOUNCE_WINDOW_US;
+
+
+static inline bool testKey(const uint8_t *bitmap, uint8_t key)
+{
+    return (bitmap[key / 8] >> (key % 8)) & 1;
+}
+
+
+static inline void setKey(uint8_t *bitmap, uint8_t key, bool isPushed)
+{
+    if (isPushed == true) {
+        bitmap[key / 8] |= 1 << (key % 8);
+    } else {
+        bitmap[key / 8] &= ~(1 << (key % 8));
+    }
+
+    return;
+}
+
+
+static bool byteOffset(const HidField *field, uint8_t *offset)
+{
+    if ((field->bit % 8) != 0 || field->bit / 8 > UINT8_MAX) {
+        return false;
+    }
+    *offset = field->bit / 8;
+
+    return true;
+}
+
+
+void clearKeyDebounce(KeyDebounce *debounce)
+{
+    (void)memset(debounce, 0, sizeof(*debounce));
+
+    return;
+}
+
+
+void bindKeyDebounce(KeyDebounce *debounce, const HidReportMap *map)
+{
+    clearKeyDebounce(debounce);
+
+    if (cWindowUs == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < map->layoutNum; ++i) {
+        const HidReportLayout *layout = &map->layoutArray[i];
+        if (layout->application != HID_APP_KEYBOARD ||
+            layout->modifier.size != 8 ||
+            byteOffset(&layout->modifier, &debounce->modifierOffset) == false) {
+            continue;
+        }
+
+        if (layout->keyArray.size == 8 && layout->keyArrayNum != 0 &&
+            byteOffset(&layout->keyArray, &debounce->keyArrayOffset) == true) {
+            debounce->keyArrayNum = layout->keyArrayNum;
+        } else if (layout->keyBitmap.size == 1 && layout->keyBitmapNum != 0) {
+            debounce->keyBitmapBit = layout->keyBitmap.bit;
+            debounce->keyBitmapFirst = layout->keyBitmap.usage;
+            debounce->keyBitmapNum = layout->keyBitmapNum;
+            if (debounce->keyBitmapFirst + debounce->keyBitmapNum > cKeyLeftControl) {
+                debounce->keyBitmapNum = cKeyLeftControl - debounce->keyBitmapFirst;
+            }
+        } else {
+            continue;
+        }
+
+        debounce->reportId = layout->reportId;
+        debounce->isEnabled = true;
+        break;
+    }
+
+    return;
+}
+
+
+// Return false if the report tells roll over error.
+static bool readKeys(const KeyDebounce *debounce, const volatile uint8_t *report,
+                     uint8_t *bitmap)
+{
+    (void)memset(bitmap, 0, 32);
+
+    {
+        uint8_t modifier = report[debounce->modifierOffset];
+        bitmap[cKeyLeftControl / 8] = modifier;
+    }
+
+    if (debounce->keyArrayNum != 0) {
+        for (uint8_t i = 0; i < debounce->keyArrayNum; ++i) {
+            uint8_t key = report[debounce->keyArrayOffset + i];
+            if (key == cKeyErrorRollOver) {
+                return false;
+            }
+            if (key != 0x00) {
+                setKey(bitmap, key, true);
+            }
+        }
+    } else {
+        for (uint16_t i = 0; i < debounce->keyBitmapNum; ++i) {
+            uint16_t bit = debounce->keyBitmapBit + i;
+            if ((report[bit / 8] >> (bit % 8)) & 1) {
+                setKey(bitmap, debounce->keyBitmapFirst + i, true);
+            }
+        }
+    }
+
+    return true;
+}
+
+
+static void writeKeys(const KeyDebounce *debounce, volatile uint8_t *report,
+                      const uint8_t *rawBitmap)
+{
+    const uint8_t *output = debounce->outputArray;
+
+    report[debounce->modifierOffset] = output[cKeyLeftControl / 8];
+
+    if (debounce->keyArrayNum != 0) {
+        volatile uint8_t *keys = &report[debounce->keyArrayOffset];
+        uint8_t keyArray[cKeyDebounceReportMax];
+        uint8_t keyNum = 0;
+
+        // Keep the pushed order of the raw report, then keys held by the filter.
+        for (uint8_t i = 0; i < debounce->keyArrayNum; ++i) {
+            uint8_t key = keys[i];
+            if (key != 0x00 && testKey(output, key) == true) {
+                keyArray[keyNum++] = key;
+            }
+        }
+        if (debounce->isPending == true) {
+            for (uint16_t key = 0x04; key < cKeyLeftControl && keyNum < debounce->keyArrayNum; ++key) {
+                if (testKey(output, key) == true && testKey(rawBitmap, key) == false) {
+                    keyArray[keyNum++] = key;
+                }
+            }
+        }
+        for (uint8_t i = 0; i < debounce->keyArrayNum; ++i) {
+            keys[i] = (i < keyNum) ? keyArray[i] : 0x00;
+        }
+    } else {
+        for (uint16_t i = 0; i < debounce->keyBitmapNum; ++i) {
+            uint16_t bit = debounce->keyBitmapBit + i;
+            uint8_t mask = 1 << (bit % 8);
+            if (testKey(output, debounce->keyBitmapFirst + i) == true) {
+                report[bit / 8] |= mask;
+            } else {
+                report[bit / 8] &= ~mask;
+            }
+        }
+    }
+
+    return;
+}
+
+
+static KeyDebounceEntry *findEntry(KeyDebounce *debounce, uint8_t key)
+{
+    for (uint8_t i = 0; i < debounce->entryNum; ++i) {
+        if (debounce->entryArray[i].key == key) {
+            return &debounce->entryArray[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+// Drop entries whose window has passed.
+static void expireEntries(KeyDebounce *debounce, uint32_t nowUs)
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < debounce->entryNum; ++i) {
+        if (nowUs - debounce->entryArray[i].time < cWindowUs) {
+            debounce->entryArray[n++] = debounce->entryArray[i];
+        }
+    }
+    debounce->entryNum = n;
+
+    return;
+}
+
+
+static void addEntry(KeyDebounce *debounce, uint8_t key, uint32_t nowUs)
+{
+    KeyDebounceEntry *entry = findEntry(debounce, key);
+
+    if (entry == NULL) {
+        if (debounce->entryNum < ARRAY_NUM(debounce->entryArray)) {
+            entry = &debounce->entryArray[debounce->entryNum++];
+        } else {
+            // Full.  Reuse the oldest one.
+            entry = &debounce->entryArray[0];
+            for (uint8_t i = 1; i < debounce->entryNum; ++i) {
+                if (nowUs - debounce->entryArray[i].time > nowUs - entry->time) {
+                    entry = &debounce->entryArray[i];
+                }
+            }
+        }
+    }
+    entry->key = key;
+    entry->time = nowUs;
+
+    return;
+}
+
+
+static void filterKeys(KeyDebounce *debounce, volatile uint8_t *report, uint32_t nowUs)
+{
+    uint8_t rawBitmap[32];
+
+    if (readKeys(debounce, report, rawBitmap) == false) {
+        return;
+    }
+
+    expireEntries(debounce, nowUs);
+
+    debounce->isPending = false;
+    for (uint16_t i = 0; i < ARRAY_NUM(rawBitmap); ++i) {
+        uint8_t diff = rawBitmap[i] ^ debounce->outputArray[i];
+        while (diff != 0) {
+            uint8_t bit = __builtin_ctz(diff);
+            uint8_t key = i * 8 + bit;
+            diff &= diff - 1;
+
+            if (findEntry(debounce, key) != NULL) {
+                // Chatter
+                debounce->isPending = true;
+            } else {
+                setKey(debounce->outputArray, key, testKey(rawBitmap, key));
+                addEntry(debounce, key, nowUs);
+            }
+        }
+    }
+
+    writeKeys(debounce, report, rawBitmap);
+
+    return;
+}
+
+
+void filterKeyDebounce(KeyDebounce *debounce, volatile uint8_t *report, uint16_t length,
+                       uint32_t nowUs)
+{
+    if (debounce->isEnabled == false) {
+        return;
+    }
+    if (debounce->reportId != 0 && report[0] != debounce->reportId) {
+        return;
+    }
+    if (length > cKeyDebounceReportMax ||
+        (debounce->keyArrayNum != 0 && debounce->keyArrayOffset + debounce->keyArrayNum > length) ||
+        (debounce->keyArrayNum == 0 && (debounce->keyBitmapBit + debounce->keyBitmapNum + 7) / 8 > length)) {
+        return;
+    }
+
+    // Keep the raw report to settle keys later.
+    for (uint16_t i = 0; i < length; ++i) {
+        debounce->rawArray[i] = report[i];
+    }
+    debounce->rawLength = length;
+
+    filterKeys(debounce, report, nowUs);
+
+    return;
+}
+
+
+bool makeKeyDebounceReport(KeyDebounce *debounce, uint8_t *report, uint16_t *length,
+                           uint32_t nowUs)
+{
+    if (debounce->isPending == false) {
+        return false;
+    }
+
+    // Wait until the window of a held key has passed.
+    {
+        uint8_t rawBitmap[32];
+        bool isSettled = false;
+
+        if (readKeys(debounce, debounce->rawArray, rawBitmap) == false) {
+            return false;
+        }
+        for (uint16_t i = 0; i < ARRAY_NUM(rawBitmap) && isSettled == false; ++i) {
+            uint8_t diff = rawBitmap[i] ^ debounce->outputArray[i];
+            while (diff != 0) {
+                uint8_t key = i * 8 + __builtin_ctz(diff);
+                const KeyDebounceEntry *entry = findEntry(debounce, key);
+                diff &= diff - 1;
+                if (entry == NULL || nowUs - entry->time >= cWindowUs) {
+                    isSettled = true;
+                    break;
+                }
+            }
+        }
+        if (isSettled == false) {
+            return false;
+        }
+    }
+
+    (void)memcpy(report, debounce->rawArray, debounce->rawLength);
+    *length = debounce->rawLength;
+    filterKeys(debounce, report, nowUs);
+
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef KEY_DEBOUNCE_H
+#define KEY_DEBOUNCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hid_report_map.h"
+
+
+// Eager debounce of keyboard reports
+// The first edge of a key passes at once.  Following transitions of the key
+// within the window are dropped as chatter.  If a key ends up in a state
+// different from the output after the window, a report is made by
+// makeKeyDebounceReport().
+// Timestamps are kept only for keys which changed within the window.
+
+// 0 disables the filter.  cmake -DKEY_DEBOUNCE_WINDOW_US=5000 ..
+#ifndef KEY_DEBOUNCE_WINDOW_US
+#define KEY_DEBOUNCE_WINDOW_US  0
+#endif
+
+#define cKeyDebounceEntryMax  16
+#define cKeyDebounceReportMax  64 // CFG_TUH_HID_EPIN_BUFSIZE
+
+typedef struct {
+    uint8_t key;
+    uint32_t time;
+} KeyDebounceEntry;
+
+typedef struct {
+    bool isEnabled;
+    uint8_t reportId;
+    uint8_t modifierOffset;
+    uint8_t keyArrayOffset;
+    uint8_t keyArrayNum; // 0 if bitmap
+    uint16_t keyBitmapBit;
+    uint16_t keyBitmapFirst;
+    uint16_t keyBitmapNum;
+
+    uint8_t outputArray[32]; // Bitmap of keycodes sent to PC (modifiers are 0xE0-0xE7)
+    uint8_t entryNum;
+    KeyDebounceEntry entryArray[cKeyDebounceEntryMax];
+
+    bool isPending; // Output differs from the last raw report
+    uint16_t rawLength;
+    uint8_t rawArray[cKeyDebounceReportMax];
+} KeyDebounce;
+
+
+// Bind to the first keyboard layout of the map.
+void bindKeyDebounce(KeyDebounce *debounce, const HidReportMap *map);
+
+void clearKeyDebounce(KeyDebounce *debounce);
+
+// Filter a raw report in place.
+void filterKeyDebounce(KeyDebounce *debounce, volatile uint8_t *report, uint16_t length,
+                       uint32_t nowUs);
+
+// Return true and make a report to settle keys if their window has passed.
+bool makeKeyDebounceReport(KeyDebounce *debounce, uint8_t *report, uint16_t *length,
+                           uint32_t nowUs);
+
+
+#endif /* #ifndef KEY_DEBOUNCE_H */
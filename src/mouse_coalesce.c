@@ -0,0 +1,117 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "buf_func.h"
+#include "mouse_coalesce.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+
+static int32_t readSigned(const volatile uint8_t *report, const HidField *field)
+{
+    uint32_t v = readBits(report, field->bit, field->size);
+    if (field->size < 32 && (v & (1u << (field->size - 1))) != 0) {
+        v |= ~((1u << field->size) - 1);
+    }
+
+    return (int32_t)v;
+}
+
+
+void clearMouseCoalesce(MouseCoalesce *coalesce)
+{
+    (void)memset(coalesce, 0, sizeof(*coalesce));
+
+    return;
+}
+
+
+void bindMouseCoalesce(MouseCoalesce *coalesce, const HidReportMap *map)
+{
+    clearMouseCoalesce(coalesce);
+
+    coalesce->hasReportId = map->hasReportId;
+
+    for (size_t i = 0; i < map->layoutNum; ++i) {
+        const HidReportLayout *layout = &map->layoutArray[i];
+        if (layout->application != HID_APP_MOUSE) {
+            continue;
+        }
+        if (coalesce->layoutNum >= ARRAY_NUM(coalesce->layoutArray)) {
+            break;
+        }
+
+        MouseCoalesceLayout *dst = &coalesce->layoutArray[coalesce->layoutNum++];
+        dst->reportId = layout->reportId;
+        for (size_t j = 0; j < layout->axisNum; ++j) {
+            const HidField *axis = &layout->axisArray[j];
+            // Absolute axes (tablets) are not summed, even with a signed range.
+            if (axis->isRelative == true && axis->size >= 2 && axis->size <= 16) {
+                dst->axisArray[dst->axisNum++] = *axis;
+            }
+        }
+    }
+
+    return;
+}
+
+
+bool mergeMouseReport(const MouseCoalesce *coalesce, volatile uint8_t *newer,
+                      const volatile uint8_t *older, uint16_t length)
+{
+    if (length == 0 || length > cMouseCoalesceReportMax) {
+        return false;
+    }
+
+    const uint8_t reportId = (coalesce->hasReportId == true) ? older[0] : 0;
+    const MouseCoalesceLayout *layout = NULL;
+    for (size_t i = 0; i < coalesce->layoutNum; ++i) {
+        if (coalesce->layoutArray[i].reportId == reportId) {
+            layout = &coalesce->layoutArray[i];
+            break;
+        }
+    }
+    if (layout == NULL || layout->axisNum == 0) {
+        return false;
+    }
+
+    // Other bits must be the same.
+    {
+        uint8_t a[cMouseCoalesceReportMax];
+        uint8_t b[cMouseCoalesceReportMax];
+        for (uint16_t i = 0; i < length; ++i) {
+            a[i] = newer[i];
+            b[i] = older[i];
+        }
+        for (size_t i = 0; i < layout->axisNum; ++i) {
+            const HidField *axis = &layout->axisArray[i];
+            if (axis->bit + axis->size > length * 8) {
+                return false;
+            }
+            writeBits(a, axis->bit, axis->size, 0);
+            writeBits(b, axis->bit, axis->size, 0);
+        }
+        if (memcmp(a, b, length) != 0) {
+            return false;
+        }
+    }
+
+    // Sums must fit.
+    int32_t sumArray[cHidAxisMax];
+    for (size_t i = 0; i < layout->axisNum; ++i) {
+        const HidField *axis = &layout->axisArray[i];
+        int32_t sum = readSigned(newer, axis) + readSigned(older, axis);
+        if (sum < axis->logicalMin || sum > axis->logicalMax) {
+            return false;
+        }
+        sumArray[i] = sum;
+    }
+
+    for (size_t i = 0; i < layout->axisNum; ++i) {
+        const HidField *axis = &layout->axisArray[i];
+        writeBits(newer, axis->bit, axis->size, (uint32_t)sumArray[i]);
+    }
+
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef MOUSE_COALESCE_H
+#define MOUSE_COALESCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hid_report_map.h"
+
+
+// Merge of successive mouse reports into one.
+// Relative axes are summed.  Reports are merged only if all other bits
+// (buttons and so on) are the same and sums fit, so no click is lost.
+
+#define cMouseCoalesceLayoutMax  2
+#define cMouseCoalesceReportMax  64 // CFG_TUD_HID_EP_BUFSIZE
+
+typedef struct {
+    uint8_t reportId;
+    uint8_t axisNum;
+    HidField axisArray[cHidAxisMax]; // Relative only
+} MouseCoalesceLayout;
+
+typedef struct {
+    bool hasReportId;
+    uint8_t layoutNum; // 0: not a mouse
+    MouseCoalesceLayout layoutArray[cMouseCoalesceLayoutMax];
+} MouseCoalesce;
+
+
+void bindMouseCoalesce(MouseCoalesce *coalesce, const HidReportMap *map);
+
+void clearMouseCoalesce(MouseCoalesce *coalesce);
+
+// Add axes of older to newer.  Return false and leave newer as is
+// if they cannot be merged.
+bool mergeMouseReport(const MouseCoalesce *coalesce, volatile uint8_t *newer,
+                      const volatile uint8_t *older, uint16_t length);
+
+
+#endif /* #ifndef MOUSE_COALESCE_H */
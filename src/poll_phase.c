@@ -0,0 +1,74 @@
+#include "poll_phase.h"
+
+
+#define cPeriodMinUs  125
+#define cPeriodMaxUs  255000
+#define cErrorInitUs  (cPollPhaseLockUs * 4) // Locked after several polls
+#define cTrackPollMax  16 // Polls between completions to correct the period
+
+
+void initPollPhase(PollPhase *phase, uint32_t periodUs)
+{
+    if (periodUs < cPeriodMinUs) {
+        periodUs = cPeriodMinUs;
+    } else if (periodUs > cPeriodMaxUs) {
+        periodUs = cPeriodMaxUs;
+    }
+    phase->periodUs = periodUs;
+    phase->pollUs = 0;
+    phase->errorUs = cErrorInitUs;
+    phase->hasPoll = false;
+
+    return;
+}
+
+
+void updatePollPhase(PollPhase *phase, uint32_t nowUs)
+{
+    if (phase->hasPoll == false) {
+        phase->pollUs = nowUs;
+        phase->hasPoll = true;
+        return;
+    }
+
+    uint32_t d = nowUs - phase->pollUs;
+    uint32_t n = (d + phase->periodUs / 2) / phase->periodUs;
+
+    if (n == 0) {
+        // Jitter of completion.  Keep the earlier anchor.
+        return;
+    }
+
+    if (n <= cTrackPollMax) {
+        int32_t error = (int32_t)(d - n * phase->periodUs);
+        uint32_t absError = (error < 0) ? -error : error;
+        phase->errorUs = (phase->errorUs * 7 + absError) / 8;
+
+        int32_t periodUs = (int32_t)phase->periodUs + error / (int32_t)(4 * n);
+        if (periodUs < cPeriodMinUs) {
+            periodUs = cPeriodMinUs;
+        } else if (periodUs > cPeriodMaxUs) {
+            periodUs = cPeriodMaxUs;
+        }
+        phase->periodUs = (uint32_t)periodUs;
+    }
+    phase->pollUs = nowUs;
+
+    return;
+}
+
+
+bool isPollPhaseLocked(const PollPhase *phase, uint32_t nowUs)
+{
+    return phase->hasPoll == true &&
+           phase->errorUs <= cPollPhaseLockUs &&
+           nowUs - phase->pollUs <= cPollPhaseTrackMaxUs;
+}
+
+
+uint32_t pollPhaseWaitUs(const PollPhase *phase, uint32_t nowUs)
+{
+    uint32_t elapsedUs = (nowUs - phase->pollUs) % phase->periodUs;
+
+    return phase->periodUs - elapsedUs;
+}
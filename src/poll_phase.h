@@ -0,0 +1,41 @@
+#ifndef POLL_PHASE_H
+#define POLL_PHASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Tracker of the time PC polls an interrupt IN endpoint.
+// A report is taken by PC only when polled, so completion of a report
+// marks a poll.  The period starts from bInterval and is corrected by
+// the phase error of each completion.
+
+// 0 disables holding mouse reports until just before a poll.
+// cmake -DMOUSE_POLL_ALIGN=0 ..
+#ifndef MOUSE_POLL_ALIGN
+#define MOUSE_POLL_ALIGN  1
+#endif
+
+#define cPollPhaseLockUs  500 // Average error to be trusted
+#define cPollPhaseTrackMaxUs  1000000 // Forget the phase after this silence
+
+typedef struct {
+    uint32_t periodUs;
+    uint32_t pollUs; // Time of the last poll
+    uint32_t errorUs; // Average of absolute phase error
+    bool hasPoll;
+} PollPhase;
+
+
+void initPollPhase(PollPhase *phase, uint32_t periodUs);
+
+// Call when a report has been taken by PC.
+void updatePollPhase(PollPhase *phase, uint32_t nowUs);
+
+bool isPollPhaseLocked(const PollPhase *phase, uint32_t nowUs);
+
+// Time to the next poll.  Valid only if locked.
+uint32_t pollPhaseWaitUs(const PollPhase *phase, uint32_t nowUs);
+
+
+#endif /* #ifndef POLL_PHASE_H */
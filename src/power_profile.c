@@ -0,0 +1,63 @@
+#include "power_profile.h"
+
+
+void initPowerProfile(PowerProfile *power, uint32_t nowUs)
+{
+    power->profile = POWER_ACTIVE;
+    power->inputUs = nowUs;
+    power->idleUs = 0;
+    power->idleNum = 0;
+    power->idleMs = 0;
+    power->wakeUs = 0;
+
+    return;
+}
+
+
+bool notifyPowerInput(PowerProfile *power, uint32_t inputUs, uint32_t nowUs)
+{
+    power->inputUs = inputUs;
+
+    if (power->profile != POWER_IDLE) {
+        return false;
+    }
+
+    power->profile = POWER_ACTIVE;
+    power->idleMs += (nowUs - power->idleUs) / 1000;
+    {
+        uint32_t wakeUs = ((int32_t)(nowUs - inputUs) > 0) ? nowUs - inputUs : 0;
+        if (wakeUs > power->wakeUs) {
+            power->wakeUs = wakeUs;
+        }
+    }
+
+    return true;
+}
+
+
+bool updatePowerProfile(PowerProfile *power, uint32_t nowUs)
+{
+#if POWER_IDLE_MS
+    if (power->profile != POWER_ACTIVE ||
+        nowUs - power->inputUs < (uint32_t)POWER_IDLE_MS * 1000) {
+        return false;
+    }
+
+    power->profile = POWER_IDLE;
+    power->idleUs = nowUs;
+    power->idleNum += 1;
+
+    return true;
+#else
+    (void)power;
+    (void)nowUs;
+
+    return false;
+#endif
+}
+
+
+uint32_t powerProfileWaitUs(const PowerProfile *power)
+{
+    return (power->profile == POWER_IDLE) ? cPowerIdleWaitUs : cPowerActiveWaitUs;
+}
@@ -0,0 +1,52 @@
+#ifndef POWER_PROFILE_H
+#define POWER_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Power/performance profile driven by input from devices.
+// Loops poll tightly while input is active.  After POWER_IDLE_MS without
+// input, loops sleep by WFE for up to one poll interval between passes.
+// Input switches back to the active profile at once.
+// Time is given by the caller, so a mocked clock can drive it.
+
+// ms without input before the idle profile.  0 disables the idle profile.
+// cmake -DPOWER_IDLE_MS=0 ..
+#ifndef POWER_IDLE_MS
+#define POWER_IDLE_MS  5000
+#endif
+
+#define cPowerActiveWaitUs  0 // Tight polling
+#define cPowerIdleWaitUs  1000 // One full-speed frame, the shortest poll interval
+
+enum {
+    POWER_ACTIVE,
+    POWER_IDLE,
+};
+
+typedef struct {
+    uint8_t profile;
+    uint32_t inputUs; // Time of the last input
+    uint32_t idleUs; // Time the idle profile was entered
+    // Statistics for telemetry
+    uint32_t idleNum; // Times the idle profile was entered
+    uint32_t idleMs; // Total time in the idle profile, updated at wake
+    uint32_t wakeUs; // Worst delay from input to the active profile
+} PowerProfile;
+
+
+void initPowerProfile(PowerProfile *power, uint32_t nowUs);
+
+// Input received at inputUs is seen at nowUs.
+// Return true if switched to the active profile.
+bool notifyPowerInput(PowerProfile *power, uint32_t inputUs, uint32_t nowUs);
+
+// Return true if switched to the idle profile.
+bool updatePowerProfile(PowerProfile *power, uint32_t nowUs);
+
+// Max time to sleep between passes of a loop.  0 means no sleep.
+uint32_t powerProfileWaitUs(const PowerProfile *power);
+
+
+#endif /* #ifndef POWER_PROFILE_H */
@@ -0,0 +1,55 @@
+#include <stddef.h>
+
+#include "report_dedup.h"
+
+
+static inline uint32_t loadWord(const volatile uint8_t *p, uint16_t n)
+{
+    uint32_t w = 0;
+    for (uint16_t i = 0; i < n && i < 4; ++i) {
+        w |= (uint32_t)p[i] << (8 * i);
+    }
+
+    return w;
+}
+
+
+void clearReportDedup(ReportDedup *dedup)
+{
+    dedup->length = 0;
+
+    return;
+}
+
+
+bool isDuplicateReport(const ReportDedup *dedup, const volatile uint8_t *report, uint16_t length)
+{
+    if (length == 0 || length != dedup->length) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < length; i += 4) {
+        if (loadWord(&report[i], length - i) != dedup->wordArray[i / 4]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void recordReportDedup(ReportDedup *dedup, const volatile uint8_t *report, uint16_t length)
+{
+    if (length > cReportDedupSizeMax) {
+        // Not comparable.  Always sent.
+        dedup->length = 0;
+        return;
+    }
+
+    for (uint16_t i = 0; i < length; i += 4) {
+        dedup->wordArray[i / 4] = loadWord(&report[i], length - i);
+    }
+    dedup->length = length;
+
+    return;
+}
@@ -0,0 +1,32 @@
+#ifndef REPORT_DEDUP_H
+#define REPORT_DEDUP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Suppression of a report same as the last one sent on the instance.
+// Only for reports of states (keyboard, consumer control, gamepad).
+// Relative values like mouse movement are not duplicates.
+
+// 0 disables.  cmake -DREPORT_DEDUP=0 ..
+#ifndef REPORT_DEDUP
+#define REPORT_DEDUP  1
+#endif
+
+#define cReportDedupSizeMax  64 // CFG_TUD_HID_EP_BUFSIZE
+
+typedef struct {
+    uint16_t length; // 0: nothing sent
+    uint32_t wordArray[cReportDedupSizeMax / 4];
+} ReportDedup;
+
+
+void clearReportDedup(ReportDedup *dedup);
+
+bool isDuplicateReport(const ReportDedup *dedup, const volatile uint8_t *report, uint16_t length);
+
+void recordReportDedup(ReportDedup *dedup, const volatile uint8_t *report, uint16_t length);
+
+
+#endif /* #ifndef REPORT_DEDUP_H */
@@ -0,0 +1,225 @@
+#include <stddef.h>
+
+#include <pico/sem.h>
+
+#include "buf_func.h"
+#include "report_ring.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+
+_Static_assert(cHidReportBufSize >= CFG_TUH_HID_EPIN_BUFSIZE,
+               "A report slot must hold a full IN endpoint buffer");
+_Static_assert(cHidReportBufSize <= UINT16_MAX, "Report length is 16-bit");
+
+
+typedef uint8_t HidReportBuf[cHidReportBufSize];
+typedef HidReportBuf HidReportBufArray[cHidReportBufArrayNum];
+static volatile HidReportBufArray sHidReportBufAA[HID_INSTANCE_MAX]; // Array of Array
+typedef uint16_t HidReportLengthArray[cHidReportBufArrayNum];
+static volatile HidReportLengthArray sHidReportLengthAA[HID_INSTANCE_MAX];
+typedef uint32_t HidReportSequenceArray[cHidReportBufArrayNum];
+static volatile HidReportSequenceArray sHidReportSequenceAA[HID_INSTANCE_MAX];
+
+// Incremented by every push.  Wraps around.
+static uint32_t sHidReportSequence = 0;
+
+static uint8_t sHidReportWriteIndexArray[HID_INSTANCE_MAX];
+static uint8_t sHidReportReadIndexArray[HID_INSTANCE_MAX];
+static uint8_t sHidReportDepthArray[HID_INSTANCE_MAX];
+
+static semaphore_t sHidReportWriteSemArray[HID_INSTANCE_MAX];
+static semaphore_t sHidReportReadSemArray[HID_INSTANCE_MAX];
+
+
+void reportRingInit(void)
+{
+    for (size_t i = 0; i < ARRAY_NUM(sHidReportDepthArray); ++i) {
+        sHidReportDepthArray[i] = cHidReportBufArrayNum;
+    }
+    for (size_t i = 0; i < ARRAY_NUM(sHidReportWriteSemArray); ++i) {
+        sem_init(&sHidReportWriteSemArray[i], cHidReportBufArrayNum, cHidReportBufArrayNum);
+    }
+    for (size_t i = 0; i < ARRAY_NUM(sHidReportReadSemArray); ++i) {
+        sem_init(&sHidReportReadSemArray[i], 0, cHidReportBufArrayNum);
+    }
+
+    for (size_t i = 0; i < ARRAY_NUM(sHidReportWriteIndexArray); ++i) {
+        sHidReportWriteIndexArray[i] = 0;
+    }
+    for (size_t i = 0; i < ARRAY_NUM(sHidReportReadIndexArray); ++i) {
+        sHidReportReadIndexArray[i] = 0;
+    }
+
+    return;
+}
+
+
+bool reportRingTryReserve(uint8_t instance)
+{
+    return sem_try_acquire(&sHidReportWriteSemArray[instance]);
+}
+
+
+void reportRingPush(uint8_t instance, const uint8_t *report, uint16_t length)
+{
+    // Avoid buffer overrun.
+    if (length > cHidReportBufSize) {
+        length = cHidReportBufSize;
+    }
+
+    {
+        uint8_t writeIndex = sHidReportWriteIndexArray[instance];
+        vCopy(sHidReportBufAA[instance][writeIndex], report, length);
+        sHidReportLengthAA[instance][writeIndex] = length;
+        sHidReportSequenceAA[instance][writeIndex] = sHidReportSequence++;
+        sHidReportWriteIndexArray[instance] = (writeIndex + 1) % sHidReportDepthArray[instance];
+    }
+
+    sem_release(&sHidReportReadSemArray[instance]);
+
+    return;
+}
+
+
+bool reportRingTryAcquire(uint8_t instance)
+{
+    return sem_try_acquire(&sHidReportReadSemArray[instance]);
+}
+
+
+volatile uint8_t *reportRingPop(uint8_t instance, uint16_t *length)
+{
+    uint8_t readIndex = sHidReportReadIndexArray[instance];
+    *length = sHidReportLengthAA[instance][readIndex];
+
+    sHidReportReadIndexArray[instance] = (readIndex + 1) % sHidReportDepthArray[instance];
+
+    return sHidReportBufAA[instance][readIndex];
+}
+
+
+void reportRingRelease(uint8_t instance)
+{
+    sem_release(&sHidReportWriteSemArray[instance]);
+
+    return;
+}
+
+
+uint32_t reportRingQueuedNum(uint8_t instance)
+{
+    int n = sem_available(&sHidReportReadSemArray[instance]);
+
+    return (n < 0) ? 0 : (uint32_t)n;
+}
+
+
+volatile uint8_t *reportRingPeek(uint8_t instance, uint16_t *length)
+{
+    if (sem_available(&sHidReportReadSemArray[instance]) <= 0) {
+        return NULL;
+    }
+
+    uint8_t readIndex = sHidReportReadIndexArray[instance];
+    *length = sHidReportLengthAA[instance][readIndex];
+
+    return sHidReportBufAA[instance][readIndex];
+}
+
+
+bool reportRingPeekSequence(uint8_t instance, uint32_t *sequence)
+{
+    if (sem_available(&sHidReportReadSemArray[instance]) <= 0) {
+        return false;
+    }
+
+    *sequence = sHidReportSequenceAA[instance][sHidReportReadIndexArray[instance]];
+
+    return true;
+}
+
+
+bool reportRingFindOldest(uint32_t instanceMask, uint8_t *instance)
+{
+    bool isFound = false;
+    uint32_t oldest = 0;
+
+    for (uint8_t i = 0; i < HID_INSTANCE_MAX; ++i) {
+        uint32_t sequence;
+        if ((instanceMask & (1u << i)) == 0 || reportRingPeekSequence(i, &sequence) == false) {
+            continue;
+        }
+        // Difference is signed to survive wrap around.
+        if (isFound == false || (int32_t)(sequence - oldest) < 0) {
+            oldest = sequence;
+            *instance = i;
+            isFound = true;
+        }
+    }
+
+    return isFound;
+}
+
+
+bool reportRingDropOldest(uint8_t instance)
+{
+    if (sem_try_acquire(&sHidReportReadSemArray[instance]) == false) {
+        return false;
+    }
+
+    uint16_t length;
+    (void)reportRingPop(instance, &length);
+    sem_release(&sHidReportWriteSemArray[instance]);
+
+    return true;
+}
+
+
+uint32_t reportRingFlush(uint8_t instance)
+{
+    uint32_t n = 0;
+
+    while (reportRingDropOldest(instance) == true) {
+        n += 1;
+    }
+
+    return n;
+}
+
+
+void reportRingReset(uint8_t instance)
+{
+    // Max permits are the depth.  A stale completion of a report sent
+    // before the reset cannot free a slot not reserved.
+    uint8_t depth = sHidReportDepthArray[instance];
+    sem_init(&sHidReportWriteSemArray[instance], depth, depth);
+    sem_init(&sHidReportReadSemArray[instance], 0, depth);
+
+    sHidReportWriteIndexArray[instance] = 0;
+    sHidReportReadIndexArray[instance] = 0;
+
+    return;
+}
+
+
+void reportRingSetDepth(uint8_t instance, uint8_t depth)
+{
+    if (depth < 1) {
+        depth = 1;
+    } else if (depth > cHidReportBufArrayNum) {
+        depth = cHidReportBufArrayNum;
+    }
+    sHidReportDepthArray[instance] = depth;
+
+    reportRingReset(instance);
+
+    return;
+}
+
+
+uint8_t reportRingDepth(uint8_t instance)
+{
+    return sHidReportDepthArray[instance];
+}
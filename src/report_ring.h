@@ -0,0 +1,72 @@
+#ifndef REPORT_RING_H
+#define REPORT_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tusb_config.h"
+
+
+// Multi buffered
+// 65536(16-bit) buffer size is required to fulfill max length,
+// but RP2040 RAM is limited.
+// Sizes are given by the build profile (sizing.h).
+#define cHidReportBufSize  REPORT_RING_SLOT_SIZE
+#define cHidReportBufArrayNum  REPORT_RING_DEPTH_MAX
+
+
+// Ring of HID reports per instance.
+// Producer is tuh_hid_report_received_cb() (core1),
+// consumer is hidTask() (core0).
+// A slot is reserved by the producer and returned by reportRingRelease()
+// after the report has been sent to PC.
+// Indexes are not protected in this module.  Callers hold sMutex.
+// Each report is stamped with a sequence number global to all instances
+// to send reports to PC in the order received from devices.
+
+void reportRingInit(void);
+
+bool reportRingTryReserve(uint8_t instance);
+
+void reportRingPush(uint8_t instance, const uint8_t *report, uint16_t length);
+
+bool reportRingTryAcquire(uint8_t instance);
+
+volatile uint8_t *reportRingPop(uint8_t instance, uint16_t *length);
+
+void reportRingRelease(uint8_t instance);
+
+// Number of reports queued and not popped
+uint32_t reportRingQueuedNum(uint8_t instance);
+
+// Next report to be popped without popping.  Return NULL if nothing queued.
+volatile uint8_t *reportRingPeek(uint8_t instance, uint16_t *length);
+
+// Sequence number of the next report to be popped.
+// Return false if nothing queued.
+bool reportRingPeekSequence(uint8_t instance, uint32_t *sequence);
+
+// Instance of the oldest report queued in instances of bits set in instanceMask.
+// Return false if nothing queued.
+bool reportRingFindOldest(uint32_t instanceMask, uint8_t *instance);
+
+// Drop the oldest queued report and free its slot.
+// Return false if nothing queued.
+bool reportRingDropOldest(uint8_t instance);
+
+// Drop all queued reports and return the number of them.
+// Reports already popped are not affected.
+uint32_t reportRingFlush(uint8_t instance);
+
+// Make the ring empty.  Reports in flight are forgotten.
+// Call when the instance is unmounted.
+void reportRingReset(uint8_t instance);
+
+// Limit the ring to depth slots (1 to cHidReportBufArrayNum) and make it empty.
+// Call at mount when the class of the instance is known.
+void reportRingSetDepth(uint8_t instance, uint8_t depth);
+
+uint8_t reportRingDepth(uint8_t instance);
+
+
+#endif /* #ifndef REPORT_RING_H */
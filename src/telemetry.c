@@ -0,0 +1,77 @@
+#include <stddef.h>
+
+#include "debug_func.h"
+#include "telemetry.h"
+
+
+#define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
+
+
+static volatile uint32_t sTelemetryArray[TELEMETRY_ID_NUM];
+static uint32_t sLoggedTelemetryArray[TELEMETRY_ID_NUM];
+static uint32_t sTelemetryTimeUs = 0;
+
+
+void telemetryInit(void)
+{
+    for (size_t i = 0; i < ARRAY_NUM(sTelemetryArray); ++i) {
+        sTelemetryArray[i] = 0;
+        sLoggedTelemetryArray[i] = 0;
+    }
+
+    return;
+}
+
+
+void telemetryCount(uint32_t id)
+{
+    if (id >= TELEMETRY_ID_NUM) {
+        return;
+    }
+
+    // Not atomic.  Only one writer per counter.
+    sTelemetryArray[id] += 1;
+
+    return;
+}
+
+
+void telemetrySet(uint32_t id, uint32_t value)
+{
+    if (id >= TELEMETRY_ID_NUM) {
+        return;
+    }
+
+    sTelemetryArray[id] = value;
+
+    return;
+}
+
+
+uint32_t telemetryGet(uint32_t id)
+{
+    if (id >= TELEMETRY_ID_NUM) {
+        return 0;
+    }
+
+    return sTelemetryArray[id];
+}
+
+
+void telemetryTask(uint32_t nowUs)
+{
+    if (nowUs - sTelemetryTimeUs < cTelemetryIntervalMs * 1000) {
+        return;
+    }
+    sTelemetryTimeUs = nowUs;
+
+    for (size_t i = 0; i < ARRAY_NUM(sTelemetryArray); ++i) {
+        uint32_t value = sTelemetryArray[i];
+        if (value != sLoggedTelemetryArray[i]) {
+            debugLog(LOG_TELEMETRY, i, value);
+            sLoggedTelemetryArray[i] = value;
+        }
+    }
+
+    return;
+}
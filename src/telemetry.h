@@ -0,0 +1,42 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+
+// Event counters and gauges for field diagnosis.
+// Changed counters are logged as LOG_TELEMETRY (id, value) by telemetryTask().
+// Each counter must have only one writer core.
+
+// Keep the order.  IDs appear in logs.
+enum {
+    TELEMETRY_HOST_REARM, // Report transfer re-armed after failure
+    TELEMETRY_HOST_PORT_RESET, // Root port reset by the stall watchdog
+    TELEMETRY_WATCHDOG_REBOOT, // Rebooted by the hardware watchdog
+    TELEMETRY_POLL_PHASE_ERROR_US, // Gauge: average phase error of mouse polls
+    TELEMETRY_MOUSE_COALESCED, // Mouse reports merged into the next one
+    TELEMETRY_POWER_IDLE, // Idle power profile entered
+    TELEMETRY_POWER_IDLE_MS, // Gauge: total time in the idle profile
+    TELEMETRY_POWER_WAKE_US, // Gauge: worst delay from input to the active profile
+    TELEMETRY_REPORT_DROPPED, // Reports from devices dropped while PC took none
+    TELEMETRY_HID_INTERFACE_DROPPED, // HID interfaces of devices not proxied
+    TELEMETRY_ID_NUM
+};
+
+#define cTelemetryIntervalMs  1000
+
+
+void telemetryInit(void);
+
+void telemetryCount(uint32_t id);
+
+void telemetrySet(uint32_t id, uint32_t value);
+
+uint32_t telemetryGet(uint32_t id);
+
+// Log changed counters at most once per cTelemetryIntervalMs.
+// Call from core0 idle loop.
+void telemetryTask(uint32_t nowUs);
+
+
+#endif /* #ifndef TELEMETRY_H */
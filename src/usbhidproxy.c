@@ -5,14 +5,28 @@
 #include <pico/multicore.h>
 #include <pico/mutex.h>
 #include <pico/sem.h>
+#include <hardware/sync.h>
+#include <hardware/watchdog.h>
 
 #include <bsp/board_api.h>
 #include <tusb.h>
+#include <host/hcd.h>
 #include "tusb_config.h"
 
 #include <pio_usb_configuration.h>
 
+#include "buf_func.h"
+#include "composite_descriptor.h"
 #include "debug_func.h"
+#include "hid_report_map.h"
+#include "hid_transform.h"
+#include "key_debounce.h"
+#include "mouse_coalesce.h"
+#include "poll_phase.h"
+#include "power_profile.h"
+#include "report_dedup.h"
+#include "report_ring.h"
+#include "telemetry.h"
 
 
 #define ARRAY_NUM(x)  (sizeof(x) / sizeof((x)[0]))
@@ -28,33 +42,21 @@ volatile uint8_t interval_override = 0;
 
 static mutex_t sMutex;
 
-// Some buffers must exist until transfer has completed.
-// No callback with the key to tell which descriptor transfer has ended.
-// Use return buffer and update with mutex to avoid complex control.
+// Descriptor snapshot
+// Descriptors must exist until transfer has completed, and no callback
+// tells which descriptor transfer has ended.  They are built once by
+// core1 and not changed while published, so tud_descriptor_*_cb() return
+// pointers into the published snapshot without lock or copy.
+// core0 requests a new snapshot only while upstream is disconnected.
 
 #define cDescriptorBufSize  256
 typedef uint8_t DescriptorBuf[cDescriptorBufSize];
-static volatile DescriptorBuf sDescriptorBuf;
-static volatile DescriptorBuf sDescriptorReturnBuf;
-static uint16_t sDescriptorStringLang = 0x0000;
-
-static volatile size_t sMountedInstanceNum = 0;
-static volatile size_t sInstanceNum = 0;
-static volatile bool sIsDeviceThere = false;
-static volatile bool sIsAllInstanceMounted = false;
-static volatile bool sIsInstanceMountedArray[HID_INSTANCE_MAX];
-
-
-static volatile uint8_t sDeviceAddrArray[HID_INSTANCE_MAX];
-
-
 
 // Only one configuration is supported because of memory constraint.
-#define cConfigurationBufSize  256
+// Large enough for the composite configuration of all instances.
+#define cConfigurationCompositeSize  (cConfigurationHeaderSize + cHidInterfaceDescriptorSize * HID_INSTANCE_MAX)
+#define cConfigurationBufSize  ((cConfigurationCompositeSize > 256) ? cConfigurationCompositeSize : 256)
 typedef uint8_t ConfigurationBuf[cConfigurationBufSize];
-static volatile ConfigurationBuf sConfigurationBuf;
-static volatile ConfigurationBuf sConfigurationReturnBuf;
-
 
 // Note that only one language is supported. (memory constraint)
 #define cStringBufSize  256
@@ -62,44 +64,195 @@ static volatile ConfigurationBuf sConfigurationReturnBuf;
 // 0xEE is not supported.
 #define cDescriptorStringMax  (4 + HID_INSTANCE_MAX)
 typedef uint8_t StringBuf[cStringBufSize];
-static volatile StringBuf sStringBufArray[cDescriptorStringMax];
-static volatile StringBuf sStringReturnBufArray[cDescriptorStringMax];
 
-static uint8_t sStringIndexArray[cDescriptorStringMax - 1];
-static uint8_t sStringIndexNum = 0;
+typedef struct {
+    StringBuf stringArray[cDescriptorStringMax]; // First for alignment of uint16_t
+    DescriptorBuf device;
+    ConfigurationBuf configuration;
+    uint16_t stringLang;
+    uint8_t stringNum;
+    uint8_t stringIndexArray[cDescriptorStringMax]; // [0] is 0 (lang)
+} DescriptorSnapshot;
+
+static DescriptorSnapshot sDescriptorSnapshot;
+// NULL while no device or being built.  Only core1 writes.
+static const DescriptorSnapshot *volatile sPublishedSnapshot = NULL;
+// Device generation requested by core0 and the one of the snapshot
+static volatile uint32_t sSnapshotRequestGeneration = 0;
+static volatile uint32_t sSnapshotGeneration = 0;
+
+// Downstream devices
+// Devices behind a hub are proxied as one composite device.  HID
+// interfaces of all devices are assigned to instances in mount order and
+// instances are kept contiguous.  The device of instance 0 gives the
+// device descriptor and strings.
+// Only core1 writes.  Fields read by core0 are written with sMutex.
+#define cDownstreamDeviceMax  CFG_TUH_DEVICE_MAX
+#define cDeviceDescriptorSize  18
+#define cDeviceSettleMs  500 // Wait for other devices behind a hub
+typedef struct {
+    bool isUsed;
+    uint8_t addr; // 0: unmounted
+    uint8_t instanceNum; // HID interfaces assigned to instances
+    uint8_t mountedNum;
+    uint8_t device[cDeviceDescriptorSize];
+    uint8_t configurationHeader[cConfigurationHeaderSize];
+} DownstreamDevice;
+static DownstreamDevice sDownstreamDeviceArray[cDownstreamDeviceMax];
+
+typedef struct {
+    uint8_t device; // Index of sDownstreamDeviceArray
+    uint8_t ordinal; // Order of the HID interface in the device
+    uint8_t hostInstance; // Instance of tuh_hid_*()
+    HidInterfaceDescriptor descriptor;
+} InstanceSource;
+static InstanceSource sInstanceSourceArray[HID_INSTANCE_MAX];
+
+// Work area of descriptors (too big for core1 stack)
+static ConfigurationBuf sHostDescriptorBuf;
 
-// #define cDescriptorReportBufSize  0x10000
-#define cDescriptorReportBufSize  0x1000 // Memory constraint
-typedef uint8_t DescriptorReportBuf[cDescriptorReportBufSize];
-static volatile DescriptorReportBuf sDescriptorReportBufArray[HID_INSTANCE_MAX];
+static volatile size_t sMountedInstanceNum = 0;
+static volatile size_t sInstanceNum = 0;
+static volatile bool sIsDeviceThere = false;
+static volatile bool sIsAllInstanceMounted = false;
+static volatile bool sIsInstanceMountedArray[HID_INSTANCE_MAX];
 
+// Incremented when a device is attached or detached.
+static volatile uint32_t sDeviceGeneration = 0;
 
-// Multi buffered
-// 65536(16-bit) buffer size is required to fulfill max length,
-// but RP2040 RAM is limited.
-// Most mice and keyboards report several bytes.
-#define cHidReportBufSize  0x100
-#define cHidReportBufArrayNum  8
-typedef uint8_t HidReportBuf[cHidReportBufSize];
-typedef HidReportBuf HidReportBufArray[cHidReportBufArrayNum];
-static volatile HidReportBufArray sHidReportBufAA[HID_INSTANCE_MAX]; // Array of Array
-typedef uint16_t HidReportLengthArray[cHidReportBufArrayNum];
-static volatile HidReportLengthArray sHidReportLengthAA[HID_INSTANCE_MAX];
 
-static uint8_t sHidReportWriteIndexArray[HID_INSTANCE_MAX];
-static uint8_t sHidReportReadIndexArray[HID_INSTANCE_MAX];
+static volatile uint8_t sDeviceAddrArray[HID_INSTANCE_MAX];
 
-static semaphore_t sHidReportWriteSemArray[HID_INSTANCE_MAX];
-static semaphore_t sHidReportReadSemArray[HID_INSTANCE_MAX];
+
+// #define cDescriptorReportBufSize  0x10000
+// Memory constraint.  Given by the build profile (sizing.h).
+// tinyusb skips a descriptor report longer than its enumeration buffer,
+// so smaller profiles use that size.  wDescriptorLength given to PC is
+// limited to it.
+#define cDescriptorReportBufSize  DESCRIPTOR_REPORT_BUF_SIZE
+typedef uint8_t DescriptorReportBuf[cDescriptorReportBufSize];
+_Static_assert(cDescriptorReportBufSize >= CFG_TUH_ENUMERATION_BUFSIZE,
+               "A descriptor report given by tinyusb must fit");
+_Static_assert(cDescriptorReportBufSize <= UINT16_MAX, "wDescriptorLength is 16-bit");
+static volatile DescriptorReportBuf sDescriptorReportBufArray[HID_INSTANCE_MAX];
 
 
 enum {
     DEVICE_NONE,
     DEVICE_MOUSE,
     DEVICE_KEYBOARD,
+    DEVICE_GAMEPAD,
 };
 static volatile uint8_t sDeviceTypeArray[HID_INSTANCE_MAX];
 
+// Bound at mount.  hidTask() only looks up by Report ID.
+static HidKernelTable sHidKernelTableArray[HID_INSTANCE_MAX];
+
+// Work area to bind kernels (too big for core1 stack)
+static HidReportMap sHidReportMap;
+
+#if KEY_DEBOUNCE_WINDOW_US
+static KeyDebounce sKeyDebounceArray[HID_INSTANCE_MAX];
+#endif
+
+// USB suspend
+// While suspended, core0 sleeps and reports from devices are not queued.
+// A report from a device only requests remote wakeup.
+#define cSuspendWaitMs  100
+static volatile bool sIsSuspended = false;
+static volatile bool sIsRemoteWakeupEnabled = false;
+static volatile bool sIsWakeupRequested = false;
+static bool sIsRemoteWakeupDone = false;
+
+// Hot swap of a device
+// When a device is attached or detached, keys and buttons are released and
+// upstream is disconnected.  When devices are settled, upstream is
+// connected and PC enumerates the proxy with new descriptors.
+#define cReleaseTimeoutMs  50
+#define cReleaseReportMax  CFG_TUD_HID_EP_BUFSIZE
+#define cDisconnectMinMs  100 // To let PC detect detach
+enum {
+    UPSTREAM_CONNECTED,
+    UPSTREAM_RELEASING,
+    UPSTREAM_DISCONNECTED,
+};
+static uint8_t sUpstreamState = UPSTREAM_CONNECTED;
+static uint32_t sUpstreamGeneration = 0;
+// True while PC takes reports.  Only core0 writes.
+// Otherwise core1 drops reports of a full ring instead of waiting for core0,
+// which may be waiting for core1 (settle of devices).
+static volatile bool sIsUpstreamAccepting = false;
+static absolute_time_t sUpstreamStateTime;
+static uint32_t sSettleGeneration = 0;
+static absolute_time_t sSettleTime;
+
+// Length of the last report per (instance, Report ID) to send a released report.
+// 0 means nothing to release.  Only core0 accesses.
+static uint8_t sReleaseLengthAA[HID_INSTANCE_MAX][cHidKernelReportIdNum];
+
+#if REPORT_DEDUP
+// The last report sent per instance.  Only core0 accesses.
+static ReportDedup sReportDedupArray[HID_INSTANCE_MAX];
+#endif
+
+// Alignment of mouse reports to polls of PC
+// A mouse report is held until just before the next poll, and following
+// reports are merged into it.  PC gets the freshest movement.
+// SOF is not used.  A low-speed bus has no SOF token.
+#define cPollLeadUs  1000
+static volatile uint8_t sEndpointIntervalArray[HID_INSTANCE_MAX]; // bInterval in ms
+static PollPhase sPollPhaseArray[HID_INSTANCE_MAX]; // Only core0 accesses.
+#if MOUSE_POLL_ALIGN
+static MouseCoalesce sMouseCoalesceArray[HID_INSTANCE_MAX];
+#endif
+
+// Stall watchdog of the host side
+// A report transfer is re-armed after every report.  If re-arm fails,
+// it is retried, then the root port is detached and enumerated again.
+// If the device does not come back or core1 stops looping, the hardware
+// watchdog reboots RP2040.
+// Silence alone is not a stall.  An idle device NAKs without limit.
+#define cRearmTimeoutUs  4000
+#define cRemountTimeoutMs  500
+#define cHardwareWatchdogMs  1000
+enum {
+    HOST_ALIVE,
+    HOST_REARMING,
+    HOST_RESETTING,
+};
+static volatile uint8_t sHostState = HOST_ALIVE;
+static uint32_t sHostStateTimeUs;
+static bool sIsRearmPendingArray[HID_INSTANCE_MAX]; // Only core1 accesses.
+static volatile uint32_t sCore1Heartbeat = 0;
+static uint32_t sCore1HeartbeatSeen = 0;
+static volatile bool sIsHostNotRecovered = false;
+
+// Power profile
+// core1 stamps input from devices and wakes core0 up.  core0 selects the
+// profile, and both cores sleep between passes as long as it allows.
+// clk_sys is not changed.  PIO-USB derives bit timing from it and keeps
+// sending SOF to idle devices.
+static volatile uint32_t sPowerInputUs = 0;
+static volatile uint32_t sPowerInputNum = 0; // Only core1 writes.
+static uint32_t sPowerInputNumSeen = 0;
+static PowerProfile sPowerProfile; // Only core0 accesses.
+static volatile uint32_t sPowerWaitUs = cPowerActiveWaitUs;
+
+// Reports made on core0 and not in the ring (in flight)
+// Their completion must not release a ring slot.
+static volatile uint8_t sSyntheticReportNumArray[HID_INSTANCE_MAX];
+
+// Report in flight per instance, for the order across instances
+// A report waits for an older one pending on a busy endpoint, at most one
+// interval of that endpoint.  Then it is sent out of order.
+// Only core0 accesses.
+typedef struct {
+    bool hasSequence; // False for a synthetic report
+    uint32_t sequence;
+    uint32_t sentUs;
+} InFlightReport;
+static InFlightReport sInFlightReportArray[HID_INSTANCE_MAX];
+
 
 
 // Prototypes
@@ -108,14 +261,50 @@ static void core1Main(void);
 
 static void hidTask(void);
 
+static void suspendTask(void);
+
+static void leaveSuspend(void);
+
+static void hotSwapTask(void);
+
+static void clearSentReports(void);
+
+static void hostWatchdogTask(void);
+
+static void snapshotTask(void);
+
+static bool isDeviceSettled(void);
+
+static void watchdogTask(void);
+
+static void powerTask(uint32_t nowUs);
+
+static void initPollPhases(void);
+
 static void initData(void);
 
 
 // Inline functions
 
+// Sleep until an event or timeout as the power profile allows.
 inline static void savePower(void)
 {
-    absolute_time_t t = make_timeout_time_us(100);
+    uint32_t waitUs = sPowerWaitUs;
+    if (waitUs == 0) {
+        return;
+    }
+
+    absolute_time_t t = make_timeout_time_us(waitUs);
+    (void)best_effort_wfe_or_timeout(t);
+
+    return;
+}
+
+
+// Sleep until an event (USB interrupt, report from a device) or timeout.
+inline static void waitSuspended(uint32_t ms)
+{
+    absolute_time_t t = make_timeout_time_ms(ms);
     (void)best_effort_wfe_or_timeout(t);
 
     return;
@@ -135,34 +324,59 @@ int main(void)
 
     mutex_init(&sMutex);
 
+    telemetryInit();
+    if (watchdog_caused_reboot() == true) {
+        debugLog(LOG_WATCHDOG_REBOOT);
+        telemetryCount(TELEMETRY_WATCHDOG_REBOOT);
+    }
+
     initData();
 
+    initPowerProfile(&sPowerProfile, time_us_32());
+
     multicore_reset_core1();
     multicore_launch_core1(core1Main);
 
-    {
-        bool isAllInstanceMounted = false;
-        do {
-            mutex_enter_blocking(&sMutex);
-            isAllInstanceMounted = sIsAllInstanceMounted;
-            mutex_exit(&sMutex);
-            if (isAllInstanceMounted == true) {
-                break;
-            }
-        } while (1);
+    // Wait for devices and their descriptors.
+    while (isDeviceSettled() == false) {
+        tight_loop_contents();
     }
 
+    sUpstreamGeneration = sSnapshotGeneration;
+
     tud_init(BOARD_TUD_RHPORT);
 
     if (board_init_after_tusb) {
         board_init_after_tusb();
     }
 
+    initPollPhases();
+
+    watchdog_enable(cHardwareWatchdogMs, true);
+
     while (1) {
         tud_task(); // tinyusb device task
 
+        sIsUpstreamAccepting = (sUpstreamState == UPSTREAM_CONNECTED &&
+                                sIsSuspended == false && tud_mounted() == true);
+
+        watchdogTask();
+
+        if (sIsSuspended == true) {
+            suspendTask();
+            continue;
+        }
+
+        hotSwapTask();
+
         hidTask();
 
+        powerTask(time_us_32());
+
+        telemetryTask(time_us_32());
+
+        debugLogFlush();
+
         savePower();
     }
 
@@ -172,12 +386,7 @@ int main(void)
 
 static void initData(void)
 {
-    for (size_t i = 0; i < ARRAY_NUM(sHidReportWriteSemArray); ++i) {
-        sem_init(&sHidReportWriteSemArray[i], cHidReportBufArrayNum, cHidReportBufArrayNum);
-    }
-    for (size_t i = 0; i < ARRAY_NUM(sHidReportReadSemArray); ++i) {
-        sem_init(&sHidReportReadSemArray[i], 0, cHidReportBufArrayNum);
-    }
+    reportRingInit();
 
     for (size_t i = 0; i < ARRAY_NUM(sDeviceAddrArray); ++i) {
         sDeviceAddrArray[i] = 0x00;
@@ -185,446 +394,1270 @@ static void initData(void)
     for (size_t i = 0; i < ARRAY_NUM(sDeviceTypeArray); ++i) {
         sDeviceTypeArray[i] = DEVICE_NONE;
     }
+    for (size_t i = 0; i < ARRAY_NUM(sHidKernelTableArray); ++i) {
+        clearHidKernelTable(&sHidKernelTableArray[i]);
+    }
+#if KEY_DEBOUNCE_WINDOW_US
+    for (size_t i = 0; i < ARRAY_NUM(sKeyDebounceArray); ++i) {
+        clearKeyDebounce(&sKeyDebounceArray[i]);
+    }
+#endif
+    for (size_t i = 0; i < ARRAY_NUM(sSyntheticReportNumArray); ++i) {
+        sSyntheticReportNumArray[i] = 0;
+    }
+    (void)memset(sReleaseLengthAA, 0, sizeof(sReleaseLengthAA));
     for (size_t i = 0; i < ARRAY_NUM(sIsInstanceMountedArray); ++i) {
         sIsInstanceMountedArray[i] = false;
     }
 
-    sDescriptorStringLang = 0x0000;
+    (void)memset(sDownstreamDeviceArray, 0, sizeof(sDownstreamDeviceArray));
+    (void)memset(sInstanceSourceArray, 0, sizeof(sInstanceSourceArray));
+
+    sPublishedSnapshot = NULL;
+    sSnapshotRequestGeneration = 0;
+    sSnapshotGeneration = 0;
+    sSettleGeneration = 0;
+    sSettleTime = get_absolute_time();
+
+    sMountedInstanceNum = 0;
+    sInstanceNum = 0;
+
+    sIsDeviceThere = false;
+    sIsAllInstanceMounted = false;
+
+    return;
+}
+
+
+static void core1Main(void)
+{
+    pio_usb_configuration_t pio_cfg = PIO_USB_DEFAULT_CONFIG;
+    tuh_configure(1, TUH_CFGID_RPI_PIO_USB_CONFIGURATION, &pio_cfg);
+
+    tuh_init(BOARD_TUH_RHPORT);
+
+    while (true) {
+        tuh_task();
+
+        hostWatchdogTask();
+
+        snapshotTask();
+
+        if (sIsSuspended == true) {
+            // Devices are still polled by PIO-USB, but no need to hurry.
+            waitSuspended(1);
+        } else {
+            savePower();
+        }
+    }
+
+    return;
+}
+
+
+static void hostReport(uint8_t instance)
+{
+    // Never wait here.  tuh_task() must go on to recover.
+    uint8_t deviceAddr = sDeviceAddrArray[instance];
+    bool r = tuh_hid_receive_report(deviceAddr, sInstanceSourceArray[instance].hostInstance);
+    if (r == false) {
+        debugLog(LOG_HOST_RECEIVE_REPORT_FAILED, deviceAddr, instance);
+    }
+    sIsRearmPendingArray[instance] = !r;
+
+    return;
+}
+
+
+// Retry re-arm, then reset the root port.  Called from core1 loop.
+static void hostWatchdogTask(void)
+{
+    uint32_t nowUs = time_us_32();
+    bool isPending = false;
+
+    sCore1Heartbeat += 1;
+
+    for (size_t instance = 0; instance < ARRAY_NUM(sIsRearmPendingArray); ++instance) {
+        if (sIsRearmPendingArray[instance] == false) {
+            continue;
+        }
+        if (sIsInstanceMountedArray[instance] == false) {
+            sIsRearmPendingArray[instance] = false;
+            continue;
+        }
+        if (tuh_hid_receive_report(sDeviceAddrArray[instance],
+                                   sInstanceSourceArray[instance].hostInstance) == true) {
+            sIsRearmPendingArray[instance] = false;
+            debugLog(LOG_HOST_REARMED, instance);
+            telemetryCount(TELEMETRY_HOST_REARM);
+            continue;
+        }
+        isPending = true;
+    }
+
+    switch (sHostState) {
+    case HOST_ALIVE:
+        if (isPending == true) {
+            sHostState = HOST_REARMING;
+            sHostStateTimeUs = nowUs;
+        }
+        break;
+    case HOST_REARMING:
+        if (isPending == false) {
+            sHostState = HOST_ALIVE;
+        } else if (nowUs - sHostStateTimeUs >= cRearmTimeoutUs) {
+            debugLog(LOG_HOST_PORT_RESET, nowUs - sHostStateTimeUs);
+            telemetryCount(TELEMETRY_HOST_PORT_RESET);
+            sHostState = HOST_RESETTING;
+            sHostStateTimeUs = nowUs;
+
+            // tinyusb unmounts the device and enumerates it again.
+            // Enumeration resets the port.
+            hcd_event_device_remove(BOARD_TUH_RHPORT, false);
+            hcd_event_device_attach(BOARD_TUH_RHPORT, false);
+        }
+        break;
+    case HOST_RESETTING:
+        if (sIsAllInstanceMounted == true) {
+            sHostState = HOST_ALIVE;
+        } else if (nowUs - sHostStateTimeUs >= cRemountTimeoutMs * 1000) {
+            if (sIsHostNotRecovered == false) {
+                debugLog(LOG_HOST_NOT_RECOVERED);
+            }
+            sIsHostNotRecovered = true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return;
+}
+
+
+// Fetch a string of a downstream device into the snapshot under a new index.
+// Return the new index, or 0 if the device has no such string.
+static uint8_t addString(DescriptorSnapshot *snapshot, uint8_t deviceAddr,
+                         uint8_t index, uint8_t newIndex)
+{
+    if (index == 0 || snapshot->stringNum >= ARRAY_NUM(snapshot->stringArray)) {
+        return 0;
+    }
+
+    uint8_t *buf = snapshot->stringArray[snapshot->stringNum];
+    uint8_t r = tuh_descriptor_get_string_sync(deviceAddr, index, snapshot->stringLang,
+                                               buf, sizeof(snapshot->stringArray[0]));
+    if (r != XFER_RESULT_SUCCESS) {
+        (void)memset(buf, 0, sizeof(snapshot->stringArray[0]));
+        return 0;
+    }
+    snapshot->stringIndexArray[snapshot->stringNum++] = newIndex;
+
+    return newIndex;
+}
+
+
+// Synthesize the composite descriptors into an unpublished snapshot.
+// Strings are renumbered: 1 to 3 for the device, 4 + n for instance n.
+static bool buildDescriptorSnapshot(DescriptorSnapshot *snapshot)
+{
+    const uint8_t instanceNum = sInstanceNum;
+    if (instanceNum == 0) {
+        return false;
+    }
+    const DownstreamDevice *primary = &sDownstreamDeviceArray[sInstanceSourceArray[0].device];
+
+    (void)memset(snapshot, 0, sizeof(*snapshot));
+    (void)memcpy(snapshot->device, primary->device, sizeof(primary->device));
+
+    {
+        uint8_t *buf = snapshot->stringArray[0];
+        snapshot->stringIndexArray[0] = 0;
+        snapshot->stringNum = 1;
+
+        uint8_t r = tuh_descriptor_get_string_sync(primary->addr, 0, 0, buf, sizeof(snapshot->stringArray[0]));
+        if (r == XFER_RESULT_SUCCESS) {
+            // Only one language supported.
+            buf[0] = 0x04;
+            (void)memset(&buf[4], 0, sizeof(snapshot->stringArray[0]) - 4);
+
+            snapshot->stringLang = (buf[3] << 8) | buf[2];
+        }
+    }
+    for (uint8_t i = 0; i < 3; ++i) { // Manufacturer, product and serial number
+        snapshot->device[14 + i] = addString(snapshot, primary->addr, primary->device[14 + i], 1 + i);
+    }
+
+    {
+        HidInterfaceDescriptor interfaceArray[HID_INSTANCE_MAX];
+        uint8_t stringIndexArray[HID_INSTANCE_MAX];
+        uint8_t attributes = primary->configurationHeader[7];
+        uint32_t power = 100 / 2; // HID device + RP2040
+
+        for (uint8_t i = 0; i < instanceNum; ++i) {
+            const InstanceSource *source = &sInstanceSourceArray[i];
+            (void)memcpy(interfaceArray[i], source->descriptor, sizeof(interfaceArray[i]));
+            stringIndexArray[i] = addString(snapshot, sDownstreamDeviceArray[source->device].addr,
+                                            source->descriptor[8], 4 + i);
+            sEndpointIntervalArray[i] = source->descriptor[9 + 9 + 6];
+        }
+        for (size_t i = 0; i < ARRAY_NUM(sDownstreamDeviceArray); ++i) {
+            const DownstreamDevice *device = &sDownstreamDeviceArray[i];
+            if (device->isUsed == true) {
+                attributes |= device->configurationHeader[7] & 0x20; // Remote wakeup
+                power += device->configurationHeader[8];
+            }
+        }
+
+        uint16_t length = buildCompositeConfiguration(snapshot->configuration, sizeof(snapshot->configuration),
+                                                      primary->configurationHeader, attributes,
+                                                      (power > UINT8_MAX) ? UINT8_MAX : power,
+                                                      interfaceArray, stringIndexArray, instanceNum);
+        if (length == 0) {
+            return false;
+        }
+    }
+    // Getting 0xEE causes error and need reset.  Skip.
+
+    return true;
+}
+
+
+// Build the snapshot requested by core0.
+static void snapshotTask(void)
+{
+    uint32_t generation = sDeviceGeneration;
+
+    if (sSnapshotRequestGeneration != generation || sSnapshotGeneration == generation ||
+        sIsAllInstanceMounted == false) {
+        return;
+    }
+
+    sPublishedSnapshot = NULL;
+    __dmb();
+    if (buildDescriptorSnapshot(&sDescriptorSnapshot) == false) {
+        return;
+    }
+    // Contents first, then the pointer.
+    __dmb();
+    sPublishedSnapshot = &sDescriptorSnapshot;
+
+    // Devices may have changed while strings were got.  core0 requests again then.
+    sSnapshotGeneration = generation;
+
+    return;
+}
+
+
+static int findDevice(uint8_t deviceAddr)
+{
+    for (size_t i = 0; i < ARRAY_NUM(sDownstreamDeviceArray); ++i) {
+        if (sDownstreamDeviceArray[i].isUsed == true && sDownstreamDeviceArray[i].addr == deviceAddr) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+
+// Instance assigned to the HID interface of a device.  -1 if none.
+static int findInstance(uint8_t deviceAddr, uint8_t hostInstance)
+{
+    for (size_t i = 0; i < sInstanceNum; ++i) {
+        if (sIsInstanceMountedArray[i] == true && sDeviceAddrArray[i] == deviceAddr &&
+            sInstanceSourceArray[i].hostInstance == hostInstance) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+
+static void updateMountState(void)
+{
+    bool isDeviceThere = false;
+    for (size_t i = 0; i < ARRAY_NUM(sDownstreamDeviceArray); ++i) {
+        if (sDownstreamDeviceArray[i].isUsed == true) {
+            isDeviceThere = true;
+        }
+    }
+
+    sIsDeviceThere = isDeviceThere;
+    sIsAllInstanceMounted = (sInstanceNum > 0 && sMountedInstanceNum == sInstanceNum);
+
+    return;
+}
+
+
+// Register a new device and assign instances to its HID interfaces.
+// Return the index of sDownstreamDeviceArray, -1 on error.
+static int attachDevice(uint8_t deviceAddr)
+{
+    // Descriptors are got without sMutex.  A sync transfer runs tuh_task()
+    // and other devices may call back.
+    uint8_t *buf = sHostDescriptorBuf;
+    uint8_t device[cDeviceDescriptorSize];
+
+    (void)memset(device, 0, sizeof(device));
+    uint8_t r = tuh_descriptor_get_device_sync(deviceAddr, device, sizeof(device));
+    if (r != XFER_RESULT_SUCCESS) {
+        return -1;
+    }
+
+    // Quick hack: if bMaxPacketSize0 is small, it seems cause error by inconsistency.
+    device[7] = CFG_TUD_ENDPOINT0_SIZE;
+
+    // The same device back from a port reset is not a swap.
+    // PC keeps the enumerated proxy and the snapshot is kept.
+    if (sHostState == HOST_RESETTING) {
+        for (size_t i = 0; i < ARRAY_NUM(sDownstreamDeviceArray); ++i) {
+            DownstreamDevice *lost = &sDownstreamDeviceArray[i];
+            if (lost->isUsed == true && lost->addr == 0 &&
+                memcmp(lost->device, device, sizeof(device)) == 0) {
+                lost->addr = deviceAddr;
+                lost->mountedNum = 0;
+                return (int)i;
+            }
+        }
+    }
+
+    (void)memset(buf, 0, sizeof(sHostDescriptorBuf));
+    // Only one default configuration.
+    r = tuh_descriptor_get_configuration_sync(deviceAddr, 0, buf, sizeof(sHostDescriptorBuf));
+    if (r != XFER_RESULT_SUCCESS) {
+        return -1;
+    }
+    uint16_t length = buf[2] | (buf[3] << 8);
+    if (length > sizeof(sHostDescriptorBuf)) {
+        length = sizeof(sHostDescriptorBuf);
+    }
+
+    mutex_enter_blocking(&sMutex);
+
+    int index = -1;
+    for (size_t i = 0; i < ARRAY_NUM(sDownstreamDeviceArray); ++i) {
+        if (sDownstreamDeviceArray[i].isUsed == false) {
+            index = (int)i;
+            break;
+        }
+    }
+    if (index < 0) {
+        mutex_exit(&sMutex);
+        return -1;
+    }
+
+    DownstreamDevice *d = &sDownstreamDeviceArray[index];
+    (void)memset(d, 0, sizeof(*d));
+    (void)memcpy(d->device, device, sizeof(d->device));
+    (void)memcpy(d->configurationHeader, buf, sizeof(d->configurationHeader));
+
+    const uint8_t hidNum = countHidInterfaces(buf, length);
+    for (uint8_t i = 0; i < hidNum && sInstanceNum < HID_INSTANCE_MAX; ++i) {
+        InstanceSource *source = &sInstanceSourceArray[sInstanceNum];
+        if (findHidInterface(buf, length, i, cDescriptorReportBufSize, source->descriptor) == false) {
+            continue;
+        }
+        source->device = index;
+        source->ordinal = d->instanceNum++;
+        source->hostInstance = 0;
+        sIsInstanceMountedArray[sInstanceNum] = false;
+        sInstanceNum += 1;
+    }
+
+    d->addr = deviceAddr;
+    d->isUsed = true;
+    sDeviceGeneration += 1;
+    updateMountState();
+
+    mutex_exit(&sMutex);
+
+    debugLog(LOG_DEVICE_ATTACHED, deviceAddr, d->instanceNum, hidNum);
+    // Over HID_INSTANCE_MAX or without an interrupt IN endpoint
+    for (uint8_t i = d->instanceNum; i < hidNum; ++i) {
+        telemetryCount(TELEMETRY_HID_INTERFACE_DROPPED);
+    }
+
+    return index;
+}
+
+
+// Move an instance to keep instances contiguous.  Call with sMutex held.
+static void moveInstance(uint8_t dst, uint8_t src)
+{
+    sInstanceSourceArray[dst] = sInstanceSourceArray[src];
+    sDeviceAddrArray[dst] = sDeviceAddrArray[src];
+    sDeviceAddrArray[src] = 0x00;
+    sIsInstanceMountedArray[dst] = sIsInstanceMountedArray[src];
+    sIsInstanceMountedArray[src] = false;
+    sIsRearmPendingArray[dst] = sIsRearmPendingArray[src];
+    sIsRearmPendingArray[src] = false;
+    sEndpointIntervalArray[dst] = sEndpointIntervalArray[src];
+
+    vCopy(sDescriptorReportBufArray[dst], sDescriptorReportBufArray[src], sizeof(sDescriptorReportBufArray[dst]));
+    sDeviceTypeArray[dst] = sDeviceTypeArray[src];
+    sDeviceTypeArray[src] = DEVICE_NONE;
+    moveHidKernelTable(&sHidKernelTableArray[dst], &sHidKernelTableArray[src]);
+#if KEY_DEBOUNCE_WINDOW_US
+    sKeyDebounceArray[dst] = sKeyDebounceArray[src];
+    clearKeyDebounce(&sKeyDebounceArray[src]);
+#endif
+#if MOUSE_POLL_ALIGN
+    sMouseCoalesceArray[dst] = sMouseCoalesceArray[src];
+    clearMouseCoalesce(&sMouseCoalesceArray[src]);
+#endif
+
+    // Upstream is reconnected.  Queued reports are dropped.
+    reportRingSetDepth(dst, reportRingDepth(src));
+    reportRingReset(src);
+
+    return;
+}
+
+
+// Forget a device whose instances are all unmounted.  Call with sMutex held.
+static void detachDevice(int index)
+{
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < sInstanceNum; ++i) {
+        if (sInstanceSourceArray[i].device == index) {
+            continue;
+        }
+        if (n != i) {
+            moveInstance(n, i);
+        }
+        n += 1;
+    }
+    sInstanceNum = n;
+
+    sDownstreamDeviceArray[index].isUsed = false;
+    sDeviceGeneration += 1;
+
+    return;
+}
+
+
+// Ring depth of the device class given by the build profile (sizing.h)
+static uint8_t getRingDepth(uint8_t deviceType)
+{
+    switch (deviceType) {
+    case DEVICE_MOUSE:
+        return REPORT_RING_DEPTH_MOUSE;
+    case DEVICE_KEYBOARD:
+        return REPORT_RING_DEPTH_KEYBOARD;
+    case DEVICE_GAMEPAD:
+        return REPORT_RING_DEPTH_GAMEPAD;
+    default:
+        break;
+    }
+
+    return REPORT_RING_DEPTH_OTHER;
+}
+
+
+void tuh_hid_mount_cb(uint8_t deviceAddr, uint8_t hostInstance,
+                      uint8_t const *descriptorReport, uint16_t descriptorLength)
+{
+#if 0
+    debugPrintf("mount deviceAddr = %02x, %u, %08x, %u",
+                 deviceAddr, (uint32_t)hostInstance, (uint32_t)descriptorReport, (uint32_t)descriptorLength);
+    {
+        for (size_t i = 0; i < descriptorLength; i += 8) {
+            debugPrintf("%02x %02x %02x %02x %02x %02x %02x %02x",
+                         descriptorReport[i],
+                         descriptorReport[i + 1],
+                         descriptorReport[i + 2],
+                         descriptorReport[i + 3],
+                         descriptorReport[i + 4],
+                         descriptorReport[i + 5],
+                         descriptorReport[i + 6],
+                         descriptorReport[i + 7]);
+        }
+    }
+#endif
+
+    int index = findDevice(deviceAddr);
+    if (index < 0) {
+        index = attachDevice(deviceAddr);
+        if (index < 0) {
+            // TODO: assert
+            return;
+        }
+    }
+    DownstreamDevice *device = &sDownstreamDeviceArray[index];
+
+    mutex_enter_blocking(&sMutex);
+
+    // tinyusb mounts HID interfaces of a device in order.
+    int found = -1;
+    for (size_t i = 0; i < sInstanceNum; ++i) {
+        if (sInstanceSourceArray[i].device == index &&
+            sInstanceSourceArray[i].ordinal == device->mountedNum) {
+            found = (int)i;
+            break;
+        }
+    }
+    if (found < 0) {
+        mutex_exit(&sMutex);
+        return;
+    }
+    const uint8_t instance = (uint8_t)found;
+    device->mountedNum += 1;
+    sInstanceSourceArray[instance].hostInstance = hostInstance;
+    sDeviceAddrArray[instance] = deviceAddr;
+
+    {
+        if (descriptorLength > sizeof(sDescriptorReportBufArray[instance])) {
+            descriptorLength = sizeof(sDescriptorReportBufArray[instance]);
+        }
+        vZero(sDescriptorReportBufArray[instance], sizeof(sDescriptorReportBufArray[instance]));
+        vCopy(sDescriptorReportBufArray[instance], descriptorReport, descriptorLength);
+
+        if (parseHidReportMap(&sHidReportMap, descriptorReport, descriptorLength) == false) {
+            // Offsets of a partial map may be wrong.  Pass reports as they are.
+            (void)memset(&sHidReportMap, 0, sizeof(sHidReportMap));
+        }
+        bindHidKernelTable(&sHidKernelTableArray[instance], &sHidReportMap);
+#if KEY_DEBOUNCE_WINDOW_US
+        bindKeyDebounce(&sKeyDebounceArray[instance], &sHidReportMap);
+#endif
+#if MOUSE_POLL_ALIGN
+        bindMouseCoalesce(&sMouseCoalesceArray[instance], &sHidReportMap);
+#endif
+
+        // Type of the first top-level application
+        sDeviceTypeArray[instance] = DEVICE_NONE;
+        for (size_t i = 0; i < sHidReportMap.layoutNum; ++i) {
+            uint8_t application = sHidReportMap.layoutArray[i].application;
+            if (application == HID_APP_MOUSE) {
+                sDeviceTypeArray[instance] = DEVICE_MOUSE;
+                break;
+            } else if (application == HID_APP_KEYBOARD) {
+                sDeviceTypeArray[instance] = DEVICE_KEYBOARD;
+                break;
+            } else if (application == HID_APP_GAMEPAD || application == HID_APP_JOYSTICK) {
+                sDeviceTypeArray[instance] = DEVICE_GAMEPAD;
+                break;
+            }
+        }
+        reportRingSetDepth(instance, getRingDepth(sDeviceTypeArray[instance]));
+    }
+
+    sIsInstanceMountedArray[instance] = true;
+
+    sMountedInstanceNum += 1;
+    updateMountState();
+
+    mutex_exit(&sMutex);
+
+    hostReport(instance);
+
+    return;
+}
+
+
+void tuh_hid_umount_cb(uint8_t deviceAddr, uint8_t hostInstance)
+{
+    mutex_enter_blocking(&sMutex);
+
+    int found = findInstance(deviceAddr, hostInstance);
+    if (found < 0) {
+        mutex_exit(&sMutex);
+        return;
+    }
+    const uint8_t instance = (uint8_t)found;
+    const int index = sInstanceSourceArray[instance].device;
+    DownstreamDevice *device = &sDownstreamDeviceArray[index];
+
+    sDeviceAddrArray[instance] = 0x00;
+
+    sIsInstanceMountedArray[instance] = false;
+
+    reportRingReset(instance);
+
+    sDeviceTypeArray[instance] = DEVICE_NONE;
+    clearHidKernelTable(&sHidKernelTableArray[instance]);
+#if KEY_DEBOUNCE_WINDOW_US
+    clearKeyDebounce(&sKeyDebounceArray[instance]);
+#endif
+#if MOUSE_POLL_ALIGN
+    clearMouseCoalesce(&sMouseCoalesceArray[instance]);
+#endif
+
+    sMountedInstanceNum -= 1;
+    device->mountedNum -= 1;
+    if (device->mountedNum == 0) {
+        device->addr = 0;
+        // Kept for the device back from a port reset.
+        if (sHostState != HOST_RESETTING) {
+            debugLog(LOG_DEVICE_DETACHED, deviceAddr);
+            detachDevice(index);
+        }
+    }
+    updateMountState();
+    if (sIsDeviceThere == false) {
+        sPublishedSnapshot = NULL;
+    }
+
+    mutex_exit(&sMutex);
+
+    return;
+}
+
+
+void tuh_hid_report_received_cb(uint8_t deviceAddr, uint8_t hostInstance,
+                                uint8_t const *report, uint16_t length)
+{
+    // debugLog(LOG_HOST_REPORT_RECEIVED, report[0], report[1], hostInstance, length);
+
+    // Only core1 changes the assignment.
+    int found = findInstance(deviceAddr, hostInstance);
+    if (found < 0) {
+        return;
+    }
+    const uint8_t instance = (uint8_t)found;
+
+    if (sIsSuspended == true) {
+        // Stale when PC resumes.  Only wake core0 up.
+        if (sIsWakeupRequested == false) {
+            debugLog(LOG_REMOTE_WAKEUP, instance);
+        }
+        sIsWakeupRequested = true;
+        __sev();
+        hostReport(instance);
+        return;
+    }
+
+    do {
+        mutex_enter_blocking(&sMutex);
+
+        bool isInstanceMounted = sIsInstanceMountedArray[instance];
+        if (isInstanceMounted == false) {
+            mutex_exit(&sMutex);
+            return;
+        }
+
+        bool r = reportRingTryReserve(instance);
+        if (r == true) {
+            break;
+        }
+        if (sIsUpstreamAccepting == false) {
+            // core0 does not drain the ring and may be waiting for core1.
+            // Keep the newest reports.
+            telemetryCount(TELEMETRY_REPORT_DROPPED);
+            if (reportRingDropOldest(instance) == true && reportRingTryReserve(instance) == true) {
+                break;
+            }
+            // All slots are in flight, and no completion comes.  Drop this one.
+            mutex_exit(&sMutex);
+            hostReport(instance);
+            return;
+        }
+        mutex_exit(&sMutex);
+        sleep_us(1);
+    } while (1);
+
+    reportRingPush(instance, report, length);
+
+    mutex_exit(&sMutex);
+
+    // Wake core0 up from the idle profile.
+    sPowerInputUs = time_us_32();
+    __dmb();
+    sPowerInputNum += 1;
+    __sev();
+
+    hostReport(instance);
+
+    return;
+}
+
+
+void tud_mount_cb(void)
+{
+    // debugPrintf("tud_mount_cb()");
+
+    // PC may leave suspend by bus reset without resume.
+    if (sIsSuspended == true) {
+        leaveSuspend();
+    }
+
+    // PC enumerated again (reboot, KVM switch) and forgot the last reports.
+    clearSentReports();
+    initPollPhases();
+
+    return;
+}
+
+
+// Invoked when device is unmounted
+void tud_umount_cb(void)
+{
+    // debugPrintf("tud_umount_cb()");
+
+    if (sIsSuspended == true) {
+        leaveSuspend();
+    }
+
+    return;
+}
+
+
+void tud_suspend_cb(bool remoteWakeupEn)
+{
+    debugLog(LOG_SUSPEND, remoteWakeupEn);
+
+    sIsRemoteWakeupEnabled = remoteWakeupEn;
+    sIsWakeupRequested = false;
+    sIsRemoteWakeupDone = false;
+    sIsSuspended = true;
+
+    return;
+}
+
+
+void tud_resume_cb(void)
+{
+    leaveSuspend();
+
+    return;
+}
+
+
+static void leaveSuspend(void)
+{
+    uint32_t n = 0;
 
-    for (size_t i = 0; i < ARRAY_NUM(sHidReportWriteIndexArray); ++i) {
-        sHidReportWriteIndexArray[i] = 0;
-    }
-    for (size_t i = 0; i < ARRAY_NUM(sHidReportReadIndexArray); ++i) {
-        sHidReportReadIndexArray[i] = 0;
+    mutex_enter_blocking(&sMutex);
+
+    sIsSuspended = false;
+
+    // Reports queued before suspend are stale.
+    for (size_t instance = 0; instance < sInstanceNum; ++instance) {
+        n += reportRingFlush(instance);
     }
 
-    sMountedInstanceNum = 0;
-    sInstanceNum = 0;
+    mutex_exit(&sMutex);
 
-    sIsDeviceThere = false;
-    sIsAllInstanceMounted = false;
+    // Send the current states even if they look the same.
+    clearSentReports();
+
+    // PC schedules polls again.
+    initPollPhases();
+
+    debugLog(LOG_RESUME, n);
 
     return;
 }
 
 
-static void core1Main(void)
+static void suspendTask(void)
 {
-    pio_usb_configuration_t pio_cfg = PIO_USB_DEFAULT_CONFIG;
-    tuh_configure(1, TUH_CFGID_RPI_PIO_USB_CONFIGURATION, &pio_cfg);
+    // Bus reset clears suspend of tinyusb without tud_resume_cb().
+    if (tud_suspended() == false) {
+        leaveSuspend();
+        return;
+    }
 
-    tuh_init(BOARD_TUH_RHPORT);
+    // Only once per suspend.  PC may not resume by some reason.
+    if (sIsWakeupRequested == true && sIsRemoteWakeupDone == false) {
+        if (sIsRemoteWakeupEnabled == true) {
+            (void)tud_remote_wakeup();
+        }
+        sIsRemoteWakeupDone = true;
+    }
 
-    while (true) {
-        tuh_task();
+    debugLogFlush();
 
-        savePower();
-    }
+    waitSuspended(cSuspendWaitMs);
 
     return;
 }
 
 
-static void vCopy(volatile void *restrict dst,
-                  volatile const void *restrict src,
-                  size_t n)
+// Send a report made on core0 (not in the ring).
+static bool submitSyntheticReport(uint8_t instance, const uint8_t *report, uint16_t length)
 {
-    volatile uint8_t *d = dst;
-    const volatile uint8_t *s = src;
+    mutex_enter_blocking(&sMutex);
 
-    for (size_t i = 0; i < n; ++i) {
-        *d++ = *s++;
+    bool isReported = tud_hid_n_report(instance, 0, report, length);
+    if (isReported == true) {
+        sSyntheticReportNumArray[instance] += 1;
+        sInFlightReportArray[instance].hasSequence = false;
+        sInFlightReportArray[instance].sentUs = time_us_32();
     }
 
-    return;
+    mutex_exit(&sMutex);
+
+    return isReported;
 }
 
 
-static void vZero(volatile void *restrict dst, size_t n)
+// Remember a sent report to release its keys and buttons at hot swap
+// and to skip the same report.
+static void recordSentReport(const HidKernelTable *kernelTable, uint8_t instance,
+                             const volatile uint8_t *report, uint16_t length)
 {
-    volatile uint8_t *d = dst;
-    for (size_t i = 0; i < n; ++i) {
-        *d++ = 0;
+    uint8_t index = hidKernelIndex(kernelTable, report);
+
+    if ((kernelTable->releaseMask & (1 << index)) != 0) {
+        sReleaseLengthAA[instance][index] = (length > cReleaseReportMax) ? cReleaseReportMax : length;
     }
 
+#if REPORT_DEDUP
+    recordReportDedup(&sReportDedupArray[instance], report, length);
+#endif
+
     return;
 }
 
 
-static void hostReport(uint8_t dAddr, uint8_t instance)
+// A report of states same as the last one sent changes nothing on PC.
+// Relative values (mouse) are always sent.
+static bool isReportSkippable(const HidKernelTable *kernelTable, uint8_t instance,
+                              const volatile uint8_t *report, uint16_t length)
 {
-    bool r;
+#if REPORT_DEDUP
+    uint8_t index = hidKernelIndex(kernelTable, report);
 
-    do {
-        r = tuh_hid_receive_report(dAddr, instance);
-        if (r == true) {
-            break;
-        }
-        debugPrintf("Failed to tuh_hid_receive_report().");
-        sleep_ms(1);
-    } while (1);
+    if ((kernelTable->dedupMask & (1 << index)) == 0) {
+        return false;
+    }
 
-    return;
+    return isDuplicateReport(&sReportDedupArray[instance], report, length);
+#else
+    (void)kernelTable;
+    (void)instance;
+    (void)report;
+    (void)length;
+
+    return false;
+#endif
 }
 
 
-void tuh_hid_mount_cb(uint8_t deviceAddr, uint8_t instance,
-                      uint8_t const *descriptorReport, uint16_t descriptorLength)
+static void clearSentReports(void)
 {
-#if 0
-    debugPrintf("mount deviceAddr = %02x, %u, %08x, %u",
-                 deviceAddr, (uint32_t)instance, (uint32_t)descriptorReport, (uint32_t)descriptorLength);
-    {
-        for (size_t i = 0; i < descriptorLength; i += 8) {
-            debugPrintf("%02x %02x %02x %02x %02x %02x %02x %02x",
-                         descriptorReport[i],
-                         descriptorReport[i + 1],
-                         descriptorReport[i + 2],
-                         descriptorReport[i + 3],
-                         descriptorReport[i + 4],
-                         descriptorReport[i + 5],
-                         descriptorReport[i + 6],
-                         descriptorReport[i + 7]);
-        }
+#if REPORT_DEDUP
+    for (size_t i = 0; i < ARRAY_NUM(sReportDedupArray); ++i) {
+        clearReportDedup(&sReportDedupArray[i]);
     }
 #endif
 
-    mutex_enter_blocking(&sMutex);
+    return;
+}
 
-    sDeviceAddrArray[instance] = deviceAddr;
 
-    if (sMountedInstanceNum == 0) {
-        for (size_t i = 0; i < ARRAY_NUM(sStringIndexArray); ++i) {
-            sStringIndexArray[i] = 0;
-        }
-        {
-            DescriptorBuf buf;
-            (void)memset(buf, 0, sizeof(buf));
-            uint8_t r = tuh_descriptor_get_device_sync(deviceAddr, buf, sizeof(buf));
-            if (r == XFER_RESULT_SUCCESS) {
-                vCopy(sDescriptorBuf, buf, sizeof(buf));
-
-                // Quick hack: if bMaxPacketSize0 is small, it seems cause error by inconsistency.
-                sDescriptorBuf[7] = CFG_TUD_ENDPOINT0_SIZE;
-
-                {
-                    uint8_t manufacturer = sDescriptorBuf[14];
-                    sStringIndexArray[sStringIndexNum++] = manufacturer;
-                    uint8_t product = sDescriptorBuf[15];
-                    sStringIndexArray[sStringIndexNum++] = product;
-                    uint8_t sn = sDescriptorBuf[16];
-                    sStringIndexArray[sStringIndexNum++] = sn;
-                }
-            } else {
-                // TODO: assert
-                mutex_exit(&sMutex);
-                return; 
+// Send a released report per (instance, Report ID) one by one.
+// Return true when nothing left.
+static bool releaseAllKeys(void)
+{
+    for (size_t instance = 0; instance < ARRAY_NUM(sReleaseLengthAA); ++instance) {
+        for (size_t index = 0; index < ARRAY_NUM(sReleaseLengthAA[instance]); ++index) {
+            uint8_t length = sReleaseLengthAA[instance][index];
+            if (length == 0) {
+                continue;
             }
-        }
-        {
-            ConfigurationBuf buf;
-            (void)memset(buf, 0, sizeof(buf));
-            // Only one default configuration.
-            uint8_t r = tuh_descriptor_get_configuration_sync(deviceAddr, 0, buf, sizeof(buf));
-            if (r == XFER_RESULT_SUCCESS) {
-                { // HID device + RP2040
-                    uint8_t power = buf[8];
-                    uint8_t newPower = power + 100 / 2;
-                    if (newPower < power) {
-                        newPower = UINT8_MAX;
-                    }
-                    buf[8] = newPower;
-                }
-                sInstanceNum = buf[4]; 
-                vCopy(sConfigurationBuf, buf, sizeof(buf));
-                {
-                    for (size_t i = 0; i < sInstanceNum; ++i) {
-                        const uint8_t interface = buf[9 + (9 + 9 + 7) * i + 8];
-                        sStringIndexArray[sStringIndexNum++] = interface;
-                    }
-                }
-            } else {
-                // TODO: assert
-                mutex_exit(&sMutex);
-                return;
+            if (tud_hid_n_ready(instance) == false) {
+                return false;
             }
-        }
-        {
-            StringBuf buf;
-            uint16_t lang = 0x0000;
-            uint8_t r;
 
-            (void)memset(buf, 0, sizeof(buf));
-            r = tuh_descriptor_get_string_sync(deviceAddr, 0, 0, buf, sizeof(buf));
-            if (r == XFER_RESULT_SUCCESS) {
-                // Only one language supported.
-                buf[0] = 0x04;
-                (void)memset(&buf[4], 0, sizeof(buf) - 4);
+            uint8_t report[cReleaseReportMax];
+            (void)memset(report, 0, length);
+            report[0] = index; // Report ID.  0 if no Report ID.
 
-                sDescriptorStringLang = lang = (buf[3] << 8) | buf[2];
-                vCopy(sStringBufArray[0], buf, sizeof(sStringBufArray[0]));
+            if (submitSyntheticReport(instance, report, length) == true) {
+                sReleaseLengthAA[instance][index] = 0;
             }
-            {
-                for (size_t i = 0; i < sStringIndexNum; ++i) {
-                    (void)memset(buf, 0, sizeof(buf));
-                    uint8_t index = sStringIndexArray[i];
-                    r = tuh_descriptor_get_string_sync(deviceAddr, index,
-                                                       lang, buf, sizeof(buf));
-                    if (r == XFER_RESULT_SUCCESS) {
-                        vCopy(sStringBufArray[index],
-                              buf, sizeof(sStringBufArray[index]));
-                    }
-                }
-            }
-            // Getting 0xEE causes error and need reset.  Skip.
+            return false;
         }
     }
 
+    return true;
+}
 
-    {
-        vZero(sDescriptorReportBufArray[instance], sizeof(sDescriptorReportBufArray[instance]));
-        vCopy(sDescriptorReportBufArray[instance], descriptorReport, descriptorLength);
 
-        // TODO: parse descriptor report
-        // Normally, the position of data to detect type is like below:
-        if (descriptorReport[0] == 0x05 && descriptorReport[1] == 0x01 &&
-            descriptorReport[2] == 0x09 && descriptorReport[3] == 0x02) {
-            sDeviceTypeArray[instance] = DEVICE_MOUSE;
-        }
-        if (descriptorReport[0] == 0x05 && descriptorReport[1] == 0x01 &&
-            descriptorReport[2] == 0x09 && descriptorReport[3] == 0x06) {
-            sDeviceTypeArray[instance] = DEVICE_KEYBOARD;
-        }
+// Feed the hardware watchdog while core1 is looping.
+static void watchdogTask(void)
+{
+    uint32_t heartbeat = sCore1Heartbeat;
+
+    if (heartbeat != sCore1HeartbeatSeen && sIsHostNotRecovered == false) {
+        watchdog_update();
+        sCore1HeartbeatSeen = heartbeat;
     }
 
-    sIsInstanceMountedArray[instance] = true;
+    return;
+}
 
-    sIsDeviceThere = true;
-    sMountedInstanceNum += 1;
-    if (sMountedInstanceNum == sInstanceNum) {
-        sIsAllInstanceMounted = true;
-    }
 
+// True when devices have been unchanged for cDeviceSettleMs and
+// the snapshot of them is published.  Request the snapshot to core1 if not.
+static bool isDeviceSettled(void)
+{
+    mutex_enter_blocking(&sMutex);
+    bool isAllInstanceMounted = sIsAllInstanceMounted;
+    uint32_t generation = sDeviceGeneration;
     mutex_exit(&sMutex);
 
-    hostReport(deviceAddr, instance);
+    if (generation != sSettleGeneration) {
+        sSettleGeneration = generation;
+        sSettleTime = get_absolute_time();
+        return false;
+    }
+    if (isAllInstanceMounted == false ||
+        absolute_time_diff_us(sSettleTime, get_absolute_time()) < cDeviceSettleMs * 1000) {
+        return false;
+    }
+    if (sSnapshotGeneration != generation) {
+        sSnapshotRequestGeneration = generation;
+        __sev();
+        return false;
+    }
 
-    return;
+    return true;
 }
 
 
-void tuh_hid_umount_cb(uint8_t deviceAddr, uint8_t instance)
+static void powerTask(uint32_t nowUs)
 {
-    (void)deviceAddr;
+    uint32_t inputNum = sPowerInputNum;
+
+    if (inputNum != sPowerInputNumSeen) {
+        sPowerInputNumSeen = inputNum;
+        __dmb();
+        if (notifyPowerInput(&sPowerProfile, sPowerInputUs, nowUs) == true) {
+            telemetrySet(TELEMETRY_POWER_IDLE_MS, sPowerProfile.idleMs);
+            telemetrySet(TELEMETRY_POWER_WAKE_US, sPowerProfile.wakeUs);
+        }
+    } else if (updatePowerProfile(&sPowerProfile, nowUs) == true) {
+        telemetrySet(TELEMETRY_POWER_IDLE, sPowerProfile.idleNum);
+    }
 
+    sPowerWaitUs = powerProfileWaitUs(&sPowerProfile);
+
+    return;
+}
+
+
+static void hotSwapTask(void)
+{
     mutex_enter_blocking(&sMutex);
 
-    sDeviceAddrArray[instance] = 0x00;
+    bool isDeviceThere = sIsDeviceThere;
+    uint32_t generation = sDeviceGeneration;
+    bool isHostResetting = (sHostState == HOST_RESETTING);
 
-    sIsInstanceMountedArray[instance] = false;
+    mutex_exit(&sMutex);
 
-    sDeviceTypeArray[instance] = DEVICE_NONE;
+    int64_t elapsedUs = absolute_time_diff_us(sUpstreamStateTime, get_absolute_time());
 
-    sIsAllInstanceMounted = false;
-    sMountedInstanceNum -= 1;
-    if (sMountedInstanceNum == 0) {
-        sStringIndexNum = 0;
+    switch (sUpstreamState) {
+    case UPSTREAM_CONNECTED:
+        // The device reset by the stall watchdog is expected back soon.
+        if ((isDeviceThere == false && isHostResetting == false) ||
+            generation != sUpstreamGeneration) {
+            debugLog(LOG_UPSTREAM_RELEASING, generation);
+            sUpstreamState = UPSTREAM_RELEASING;
+            sUpstreamStateTime = get_absolute_time();
+        }
+        break;
+    case UPSTREAM_RELEASING:
+        if (releaseAllKeys() == true || elapsedUs >= cReleaseTimeoutMs * 1000) {
+            (void)memset(sReleaseLengthAA, 0, sizeof(sReleaseLengthAA));
+            (void)tud_disconnect();
+            debugLog(LOG_UPSTREAM_DISCONNECTED, (uint32_t)elapsedUs);
+            sUpstreamState = UPSTREAM_DISCONNECTED;
+            sUpstreamStateTime = get_absolute_time();
+        }
+        break;
+    case UPSTREAM_DISCONNECTED:
+        if (elapsedUs >= cDisconnectMinMs * 1000 && isDeviceSettled() == true) {
+            // Reports in flight were lost by disconnect.
+            mutex_enter_blocking(&sMutex);
+            for (size_t i = 0; i < ARRAY_NUM(sSyntheticReportNumArray); ++i) {
+                sSyntheticReportNumArray[i] = 0;
+            }
+            generation = sSnapshotGeneration;
+            sUpstreamGeneration = generation;
+            mutex_exit(&sMutex);
 
-        sIsDeviceThere = false;
-    }
+            // PC forgot the last reports.
+            clearSentReports();
+            initPollPhases();
 
-    mutex_exit(&sMutex);
+            (void)tud_connect();
+            debugLog(LOG_UPSTREAM_CONNECTED, generation);
+            sUpstreamState = UPSTREAM_CONNECTED;
+            sUpstreamStateTime = get_absolute_time();
+        }
+        break;
+    default:
+        break;
+    }
 
     return;
 }
 
 
-void tuh_hid_report_received_cb(uint8_t deviceAddr, uint8_t instance,
-                                uint8_t const *report, uint16_t length)
+#if KEY_DEBOUNCE_WINDOW_US
+// Send keys held by debounce filter after their window.
+static void settleKeyDebounce(uint8_t instance)
 {
-    // debugPrintf("report received cb: %02x %02x : %08x (%u)", report[0], report[1], report, length);
-    do {
-        mutex_enter_blocking(&sMutex);
+    uint8_t report[cKeyDebounceReportMax];
+    uint16_t length = 0;
+    uint32_t sequence;
 
-        bool isInstanceMounted = sIsInstanceMountedArray[instance];
-        if (isInstanceMounted == false) {
-            mutex_exit(&sMutex);
-            return;
-        }
+    if (tud_hid_n_ready(instance) == false) {
+        return;
+    }
 
-        bool r = sem_try_acquire(&sHidReportWriteSemArray[instance]);
-        if (r == true) {
-            break;
-        }
-        mutex_exit(&sMutex);
-        sleep_us(1);
-    } while (1);
+    mutex_enter_blocking(&sMutex);
 
-    // Avoid buffer overrun.
-    if (length > cHidReportBufSize) {
-        length = cHidReportBufSize;
+    if (sIsAllInstanceMounted == false || sDeviceTypeArray[instance] != DEVICE_KEYBOARD) {
+        mutex_exit(&sMutex);
+        return;
     }
+    // Queued reports first.  They are filtered as well.
+    if (reportRingPeekSequence(instance, &sequence) == true) {
+        mutex_exit(&sMutex);
+        return;
+    }
+    const HidKernelTable *kernelTable = &sHidKernelTableArray[instance];
 
-    {
-        uint8_t writeIndex = sHidReportWriteIndexArray[instance];
-        vCopy(sHidReportBufAA[instance][writeIndex], report, length);
-        sHidReportLengthAA[instance][writeIndex] = length;
-        sHidReportWriteIndexArray[instance] = (writeIndex + 1) % cHidReportBufArrayNum;
+    mutex_exit(&sMutex);
+
+    if (makeKeyDebounceReport(&sKeyDebounceArray[instance], report, &length, time_us_32()) == false) {
+        return;
     }
 
-    sem_release(&sHidReportReadSemArray[instance]);
+    runHidKernel(kernelTable, report, length);
 
-    mutex_exit(&sMutex);
+    if (isReportSkippable(kernelTable, instance, report, length) == true) {
+        return;
+    }
 
-    hostReport(deviceAddr, instance);
+    bool isReported = submitSyntheticReport(instance, report, length);
+    if (isReported == true) {
+        recordSentReport(kernelTable, instance, report, length);
+    } else {
+        debugLog(LOG_DEVICE_REPORT_FAILED, instance, length);
+    }
 
     return;
 }
+#endif
 
 
-void tud_mount_cb(void)
+static void initPollPhases(void)
 {
-    // debugPrintf("tud_mount_cb()");
+    for (size_t i = 0; i < ARRAY_NUM(sPollPhaseArray); ++i) {
+        initPollPhase(&sPollPhaseArray[i], sEndpointIntervalArray[i] * 1000);
+    }
 
     return;
 }
 
 
-// Invoked when device is unmounted
-void tud_umount_cb(void)
+#if MOUSE_POLL_ALIGN
+// Hold a mouse report until the next poll is near.
+// Not held while the phase is unknown or the ring is filling up.
+static bool isMouseReportHeld(uint8_t instance)
 {
-    // debugPrintf("tud_umount_cb()");
+    const PollPhase *phase = &sPollPhaseArray[instance];
+    uint32_t nowUs = time_us_32();
 
-    return;
+    if (isPollPhaseLocked(phase, nowUs) == false) {
+        return false;
+    }
+    if (reportRingQueuedNum(instance) >= reportRingDepth(instance) / 2) {
+        return false;
+    }
+
+    return pollPhaseWaitUs(phase, nowUs) > cPollLeadUs;
 }
 
 
-void tud_suspend_cb(bool remoteWakeupEn)
+// Merge following reports of the instance into the last one and
+// release slots of older ones.  Reports of other instances received
+// earlier are not overtaken.  Call with sMutex held.
+static volatile uint8_t *coalesceMouseReports(uint8_t instance,
+                                              volatile uint8_t *report, uint16_t *length)
 {
-    (void)remoteWakeupEn;
+    const MouseCoalesce *coalesce = &sMouseCoalesceArray[instance];
 
-    return;
+    while (1) {
+        uint8_t oldest = instance;
+        uint16_t nextLength = 0;
+        volatile uint8_t *next = reportRingPeek(instance, &nextLength);
+        if (next == NULL || nextLength != *length) {
+            break;
+        }
+        if (reportRingFindOldest((1u << sInstanceNum) - 1, &oldest) == false || oldest != instance) {
+            break;
+        }
+        if (mergeMouseReport(coalesce, next, report, *length) == false) {
+            break;
+        }
+
+        (void)reportRingTryAcquire(instance);
+        report = reportRingPop(instance, length);
+        // Slots are freed in order.  The older slot is the one released.
+        reportRingRelease(instance);
+        telemetryCount(TELEMETRY_MOUSE_COALESCED);
+    }
+
+    return report;
 }
+#endif
 
 
-void tud_resume_cb(void)
+// True if a busy instance other than instance holds a report older than
+// sequence, in flight or queued, and has not been polled for one interval.
+static bool isOlderReportPending(uint8_t instance, uint32_t sequence,
+                                 uint32_t readyMask, uint32_t nowUs)
 {
-    return;
+    for (uint8_t i = 0; i < sInstanceNum; ++i) {
+        if (i == instance || (readyMask & (1u << i)) != 0) {
+            continue;
+        }
+
+        const InFlightReport *inFlight = &sInFlightReportArray[i];
+        uint32_t pending;
+        if (inFlight->hasSequence == true) {
+            pending = inFlight->sequence;
+        } else if (reportRingPeekSequence(i, &pending) == false) {
+            continue;
+        }
+        // Difference is signed to survive wrap around.
+        if ((int32_t)(pending - sequence) >= 0) {
+            continue;
+        }
+
+        uint32_t intervalUs = ((sEndpointIntervalArray[i] > 0) ? sEndpointIntervalArray[i] : 1) * 1000;
+        if (nowUs - inFlight->sentUs < intervalUs) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 
 static void hidTask(void)
 {
-    if (tud_hid_ready() == false) {
+    if (sUpstreamState != UPSTREAM_CONNECTED) {
+        return;
+    }
+
+#if KEY_DEBOUNCE_WINDOW_US
+    for (size_t instance = 0; instance < sInstanceNum; ++instance) {
+        settleKeyDebounce(instance);
+    }
+#endif
+
+    uint32_t readyMask = 0;
+    for (uint8_t i = 0; i < sInstanceNum; ++i) {
+        if (tud_hid_n_ready(i) == true) {
+            readyMask |= 1u << i;
+        }
+    }
+    if (readyMask == 0) {
         if (tud_ready()) {
-            // debugPrintf("hid not ready, tud ready");
+            // debugLog(LOG_DEVICE_HID_NOT_READY);
         }
-        if (tud_suspended() == true) {
-            tud_remote_wakeup();
+        return;
+    }
+
+    mutex_enter_blocking(&sMutex);
+
+    {
+        // Instances may have been renumbered.  Wait for the hot swap.
+        bool isAllInstanceMounted = sIsAllInstanceMounted;
+        if (isAllInstanceMounted == false || sDeviceGeneration != sUpstreamGeneration) {
+            mutex_exit(&sMutex);
+            return;
         }
+    }
+
+    // Reports are sent in the order received across instances.
+    // PC polls endpoints in its own order, so a report waits while an older
+    // one is pending on another endpoint, up to one interval of it.
+    // Endpoints without older reports are not delayed by this.
+    uint8_t instance = 0;
+    uint32_t sequence = 0;
+    if (reportRingFindOldest(readyMask, &instance) == false ||
+        reportRingPeekSequence(instance, &sequence) == false) {
+        mutex_exit(&sMutex);
+        return;
+    }
+    if (isOlderReportPending(instance, sequence, readyMask, time_us_32()) == true) {
+        mutex_exit(&sMutex);
+        return;
+    }
+    uint8_t deviceType = sDeviceTypeArray[instance];
+#if MOUSE_POLL_ALIGN
+    if (deviceType == DEVICE_MOUSE && isMouseReportHeld(instance) == true) {
+        mutex_exit(&sMutex);
+        return;
+    }
+#endif
+    if (reportRingTryAcquire(instance) == false) {
+        mutex_exit(&sMutex);
         return;
     }
-    for (size_t instance = 0; instance < sInstanceNum; ++instance) {
-        bool r = sem_try_acquire(&sHidReportReadSemArray[instance]);
-        if (r == true) {
-            mutex_enter_blocking(&sMutex);
 
-            {
-                bool isAllInstanceMounted = sIsAllInstanceMounted;
-                if (isAllInstanceMounted == false) {
-                    mutex_exit(&sMutex);
-                    return;
-                }
-            }
+    uint16_t length = 0;
+    volatile uint8_t *report = reportRingPop(instance, &length);
+#if MOUSE_POLL_ALIGN
+    if (deviceType == DEVICE_MOUSE) {
+        report = coalesceMouseReports(instance, report, &length);
+    }
+#endif
 
-            uint8_t readIndex = sHidReportReadIndexArray[instance];
-            uint16_t length = sHidReportLengthAA[instance][readIndex];
+    const HidKernelTable *kernelTable = &sHidKernelTableArray[instance];
 
-            sHidReportReadIndexArray[instance] = (readIndex + 1) % cHidReportBufArrayNum;
+    mutex_exit(&sMutex);
 
-            uint8_t deviceType = sDeviceTypeArray[instance];
+#if KEY_DEBOUNCE_WINDOW_US
+    if (deviceType == DEVICE_KEYBOARD) {
+        filterKeyDebounce(&sKeyDebounceArray[instance], report, length, time_us_32());
+    }
+#else
+    (void)deviceType;
+#endif
 
-            mutex_exit(&sMutex);
+    runHidKernel(kernelTable, report, length);
 
-            if (deviceType == DEVICE_MOUSE) {
-                // Normally, buttons is in the first byte.
-                // TODO: parse descriptor report
-                uint8_t buttons = sHidReportBufAA[instance][readIndex][0];
-                buttons = (buttons & ~0x03) | ((buttons >> 1) & 0x1) | ((buttons & 0x1) << 1);
-                sHidReportBufAA[instance][readIndex][0] = buttons;
-            } else if (deviceType == DEVICE_KEYBOARD) {
-                uint8_t firstByte = sHidReportBufAA[instance][readIndex][0];
-                bool isControlPushed = (firstByte & 0x1);
-                size_t capsIndex = 0;
-
-                for (size_t i = 2; i < length; ++i) {
-                    uint8_t c = sHidReportBufAA[instance][readIndex][i];
-                    if (c == 0x39) { // caps
-                        capsIndex = i;
-                        break;
-                    }
-                }
-
-                // The keycodes are listed by the pushed order.
-                // (First pushed key is located in the first byte,
-                // second pushed key is in the second byte)
-                // In some case, the order is not maintained in some case, but
-                // it must work in most cases...
-                if (capsIndex != 0) {
-                    firstByte |= 0x01;
-
-                    if (isControlPushed == false) {
-                        for (uint16_t i = capsIndex; i < length - 1; ++i) {
-                            sHidReportBufAA[instance][readIndex][i] =
-                                sHidReportBufAA[instance][readIndex][i + 1];
-                        }
-                        sHidReportBufAA[instance][readIndex][length - 1] = 0x00;
-                    }
-                } else if (isControlPushed == true) {
-                    firstByte &= ~0x01;
-                    // To emulate FIFO, it must check new and old buffer.
-                    // It loads much, but in most cases no need to do so.
-                    // Put caps at the end of buffer.
-                    uint16_t i = 2;
-                    for ( ; i < length; ++i) {
-                        if (sHidReportBufAA[instance][readIndex][i] == 0x00) {
-                            sHidReportBufAA[instance][readIndex][i] = 0x39;
-                            break;
-                        }
-                    }
-                    if (i == length) {
-                        for (i = 0; i < length - 1; ++i) {
-                            sHidReportBufAA[instance][readIndex][i] =
-                                sHidReportBufAA[instance][readIndex][i + 1];
-                        }
-                        sHidReportBufAA[instance][readIndex][length - 1] = 0x39;
-                    }
-                }
-
-                sHidReportBufAA[instance][readIndex][0] = firstByte;
-            }
-          
-            bool isReported = tud_hid_report(instance,
-                                             (uint8_t const *)(sHidReportBufAA[instance][readIndex]), length);
+    if (isReportSkippable(kernelTable, instance, report, length) == true) {
+        // No completion comes for a report not sent.
+        mutex_enter_blocking(&sMutex);
+        if (sIsInstanceMountedArray[instance] == true) {
+            reportRingRelease(instance);
+        }
+        mutex_exit(&sMutex);
+        return;
+    }
+
+    // Report ID is already in the report.
+    bool isReported = tud_hid_n_report(instance, 0, (uint8_t const *)report, length);
 #if 0
-            {
-                for (size_t i = 0; i < length; i += 8) {
-                    debugPrintf("%02x %02x %02x %02x %02x %02x %02x %02x",
-                                 sHidReportBufArray[readIndex][i],
-                                 sHidReportBufArray[readIndex][i + 1],
-                                 sHidReportBufArray[readIndex][i + 2],
-                                 sHidReportBufArray[readIndex][i + 3],
-                                 sHidReportBufArray[readIndex][i + 4],
-                                 sHidReportBufArray[readIndex][i + 5],
-                                 sHidReportBufArray[readIndex][i + 6],
-                                 sHidReportBufArray[readIndex][i + 7]);
-                }
-            }
+    {
+        volatile uint8_t *p = report;
+        debugLog(LOG_DEVICE_REPORT_SENT, instance, length,
+                 (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3],
+                 (p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7]);
+    }
 #endif
-            if (isReported == false) {
-                debugPrintf("Failed to tud_hid_report().");
-            }
-        }
+    if (isReported == true) {
+        sInFlightReportArray[instance].hasSequence = true;
+        sInFlightReportArray[instance].sequence = sequence;
+        sInFlightReportArray[instance].sentUs = time_us_32();
+        recordSentReport(kernelTable, instance, report, length);
+    } else {
+        debugLog(LOG_DEVICE_REPORT_FAILED, instance, length);
     }
 
     return;
@@ -638,6 +1671,13 @@ void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_
 
     // debugPrintf("tud_hid_report_complete_cb()");
 
+    // PC has just polled.
+    sInFlightReportArray[instance].hasSequence = false;
+    updatePollPhase(&sPollPhaseArray[instance], time_us_32());
+    if (sDeviceTypeArray[instance] == DEVICE_MOUSE) {
+        telemetrySet(TELEMETRY_POLL_PHASE_ERROR_US, sPollPhaseArray[instance].errorUs);
+    }
+
     mutex_enter_blocking(&sMutex);
 
     if (sIsInstanceMountedArray[instance] == false) {
@@ -645,7 +1685,11 @@ void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_
         return;
     }
 
-    sem_release(&sHidReportWriteSemArray[instance]);
+    if (sSyntheticReportNumArray[instance] > 0) {
+        sSyntheticReportNumArray[instance] -= 1;
+    } else {
+        reportRingRelease(instance);
+    }
   
     mutex_exit(&sMutex);
 
@@ -700,20 +1744,13 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t reportId,
 uint8_t const *tud_descriptor_device_cb(void)
 {
     // debugPrintf("tud_descriptor_device_cb()");
-    bool isDeviceThere = false;
+    const DescriptorSnapshot *snapshot = sPublishedSnapshot;
 
-    mutex_enter_blocking(&sMutex);
-
-    isDeviceThere = sIsDeviceThere;
-    if (isDeviceThere == false) {
-        mutex_exit(&sMutex);
+    if (snapshot == NULL) {
         return NULL;
     }
-    vCopy(sDescriptorReturnBuf, sDescriptorBuf, cDescriptorBufSize);
-
-    mutex_exit(&sMutex);
 
-    return (uint8_t const *)sDescriptorReturnBuf;
+    return snapshot->device;
 }
 
 
@@ -722,58 +1759,38 @@ uint8_t const *tud_descriptor_configuration_cb(uint8_t index)
     (void)index;
 
     // debugPrintf("tud_descriptor_configuration_cb()");
-    bool isDeviceThere = false;
-
-    mutex_enter_blocking(&sMutex);
+    const DescriptorSnapshot *snapshot = sPublishedSnapshot;
 
-    isDeviceThere = sIsDeviceThere;
-    if (isDeviceThere == false) {
-        mutex_exit(&sMutex);
+    if (snapshot == NULL) {
         return NULL;
     }
 
-    vCopy(sConfigurationReturnBuf, sConfigurationBuf, cConfigurationBufSize);
-
-    mutex_exit(&sMutex);
-
-    return (uint8_t const *)sConfigurationReturnBuf;
+    return snapshot->configuration;
 }
 
 
 uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
 {
     // debugPrintf("descriptor string cb: %02x %04x", (uint32_t)index, (uint32_t)langid);
-    bool isDeviceThere = false;
-    uint16_t lang = 0x0000;
-
-    mutex_enter_blocking(&sMutex);
+    const DescriptorSnapshot *snapshot = sPublishedSnapshot;
 
-    isDeviceThere = sIsDeviceThere;
-    lang = sDescriptorStringLang;
-    if (isDeviceThere == false) {
-        mutex_exit(&sMutex);
+    if (snapshot == NULL) {
         return NULL;
     }
-    
-    if (index != 0x00 && langid != lang) {
-        debugPrintf("not?: %02x  %04x", index, langid);
-        mutex_exit(&sMutex);
+
+    if (index != 0x00 && langid != snapshot->stringLang) {
+        debugLog(LOG_DESCRIPTOR_STRING_LANG, index, langid);
         return NULL;
     }
 
-    if (index == 0xEE) { // Not supported
-        mutex_exit(&sMutex);
-        return NULL;
-    } else {
-        vCopy(sStringReturnBufArray[index],
-              sStringBufArray[index],
-              sizeof(sStringReturnBufArray[index]));
-        mutex_exit(&sMutex);
-        return (uint16_t const *)sStringReturnBufArray[index];
+    // 0xEE is not in the snapshot.
+    for (size_t i = 0; i < snapshot->stringNum; ++i) {
+        if (snapshot->stringIndexArray[i] == index) {
+            return (uint16_t const *)snapshot->stringArray[i];
+        }
     }
 
-    debugPrintf("Not reach");
-    // TODO: assert
+    return NULL;
 }
 
 
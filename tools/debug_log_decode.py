@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# Decode the deferred binary log of usbhidproxy.
+#
+# usage: debug_log_decode.py [-f src/debug_log_format.h] [capture.bin]
+#   or:  debug_log_decode.py -p /dev/ttyUSB0   (requires pyserial)
+#
+# Frame: A5 5A, id(u16), info(u8), seq(u8), time(u32), args(u32 x 4)
+# info bit 7 is core, bit 0-2 is number of arguments.
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = b'\xa5\x5a'
+RECORD = struct.Struct('<HBBI4I')
+
+DEFAULT_FORMAT = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                              '..', 'src', 'debug_log_format.h')
+
+
+def load_formats(path):
+    formats = []
+    pattern = re.compile(r'^\s*X\((\w+),\s*"((?:[^"\\]|\\.)*)"\)')
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = pattern.match(line)
+            if m:
+                formats.append((m.group(1), m.group(2)))
+    return formats
+
+
+def read_stream(args):
+    if args.port:
+        import serial
+        port = serial.Serial(args.port, args.baud)
+        while True:
+            yield port.read(port.in_waiting or 1)
+    else:
+        f = open(args.input, 'rb') if args.input else sys.stdin.buffer
+        while True:
+            data = f.read(4096)
+            if not data:
+                return
+            yield data
+
+
+def decode(formats, chunks):
+    buf = b''
+    for chunk in chunks:
+        buf += chunk
+        while True:
+            pos = buf.find(SYNC)
+            if pos < 0:
+                buf = buf[-1:]
+                break
+            if len(buf) < pos + len(SYNC) + RECORD.size:
+                buf = buf[pos:]
+                break
+            body = buf[pos + len(SYNC):pos + len(SYNC) + RECORD.size]
+            log_id, info, seq, time, *values = RECORD.unpack(body)
+            arg_num = info & 0x7
+            core = info >> 7
+            if log_id >= len(formats) or arg_num > 4:
+                # False sync.  Skip a byte.
+                buf = buf[pos + 1:]
+                continue
+            buf = buf[pos + len(SYNC) + RECORD.size:]
+            name, fmt = formats[log_id]
+            try:
+                text = fmt % tuple(values[:arg_num])
+            except (TypeError, ValueError):
+                text = '%s %s' % (fmt, values[:arg_num])
+            print('%10u.%06u core%u #%3u %s: %s'
+                  % (time // 1000000, time % 1000000, core, seq, name, text),
+                  flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-f', '--format', default=DEFAULT_FORMAT)
+    parser.add_argument('-p', '--port')
+    parser.add_argument('-b', '--baud', type=int, default=115200)
+    parser.add_argument('input', nargs='?')
+    args = parser.parse_args()
+
+    decode(load_formats(args.format), read_stream(args))
+
+
+if __name__ == '__main__':
+    main()